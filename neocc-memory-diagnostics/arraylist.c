@@ -8,7 +8,7 @@ ArrayList* new_array_list()
 {
     static_assert(sizeof(List) == 48, "incomplete implementation of List");
     static_assert(sizeof(ArrayList) == 64, "incomplete construction of ArrayList");
-    ArrayList* self = calloc(1, sizeof(ArrayList));
+    ArrayList* self = _calloc(1, sizeof(ArrayList));
     *self = (ArrayList) {
         .delete = delete_array_list,
         .length = array_list_length,
@@ -24,8 +24,8 @@ ArrayList* new_array_list()
 
 void delete_array_list(ArrayList* self)
 {
-    free(self->m_elements);
-    free(self);
+    _free(self->m_elements);
+    _free(self);
 }
 
 size_t array_list_length(ArrayList* self)
@@ -44,14 +44,14 @@ void* array_list_get(ArrayList* self, int index)
 void array_list_add(ArrayList* self, void* element)
 {
     self->m_length++;
-    self->m_elements = realloc(self->m_elements, sizeof(void*) * self->m_length);
+    self->m_elements = _realloc(self->m_elements, sizeof(void*) * self->m_length);
     self->m_elements[self->m_length - 1] = element;
 }
 
 void array_list_free_all(ArrayList* self)
 {
     for (int i = 0; i < self->m_length; i++)
-        free(self->m_elements[i]);
+        _free(self->m_elements[i]);
 }
 
 void array_list_delete_all(ArrayList* self, void (*deletor)(void* element))
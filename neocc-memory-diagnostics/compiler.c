@@ -7,7 +7,7 @@
 Compiler* new_compiler(List* ast)
 {
     static_assert(sizeof(Compiler) == 32, "incomplete construction of Compiler");
-    Compiler* self = calloc(1, sizeof(Compiler));
+    Compiler* self = _calloc(1, sizeof(Compiler));
     *self = (Compiler) {
         .ast = ast,
         .assembly = new_string_builder(),
@@ -20,7 +20,7 @@ Compiler* new_compiler(List* ast)
 void delete_compiler(Compiler* self)
 {
     delete_string_builder(self->assembly);
-    free(self);
+    _free(self);
 }
 
 char* compiler_compile(Compiler* self)
@@ -77,7 +77,7 @@ void compiler_make_function_definition(Compiler* self, FuncDefNode* node)
     self->inside_function = false;
     self->current_function_name = NULL;
     
-    free(name);
+    _free(name);
 }
 
 void compiler_make_return(Compiler* self, ReturnNode* node)
@@ -101,7 +101,7 @@ void compiler_make_int_literal(Compiler* self, IntNode* node)
 {
     char* value_string = chars_to_string(node->token->value, node->token->length);
     int value = atoi(value_string);
-    free(value_string);
+    _free(value_string);
     string_builder_write_fmt(self->assembly, "    movl $%d, %%eax\n", value);
 }
 
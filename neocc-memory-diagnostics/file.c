@@ -5,7 +5,7 @@
 
 FileReader* new_file_reader(const char* path)
 {
-    FileReader* self = calloc(1, sizeof(FileReader));
+    FileReader* self = _calloc(1, sizeof(FileReader));
     *self = (FileReader) {
         .fp = fopen(path, "r"),
     };
@@ -16,7 +16,7 @@ FileReader* new_file_reader(const char* path)
 void delete_file_reader(FileReader* self)
 {
     fclose(self->fp);
-    free(self);
+    _free(self);
 }
 
 size_t file_reader_length(FileReader* self)
@@ -29,7 +29,7 @@ char* file_reader_read(FileReader* self)
 {
     size_t length = file_reader_length(self);
     fseek(self->fp, 0, SEEK_SET);
-    char* content = calloc(length + 1, sizeof(char));
+    char* content = _calloc(length + 1, sizeof(char));
     fread(content, length, length, self->fp);
     for (int i = 0; i < length; i++)
         if (content[i] == EOF)
@@ -47,7 +47,7 @@ char* read_file(const char* path)
 
 FileWriter* new_file_writer(const char* path)
 {
-    FileWriter* self = calloc(1, sizeof(FileWriter));
+    FileWriter* self = _calloc(1, sizeof(FileWriter));
     *self = (FileWriter) {
         .fp = fopen(path, "w"),
     };
@@ -58,7 +58,7 @@ FileWriter* new_file_writer(const char* path)
 void delete_file_writer(FileWriter* self)
 {
     fclose(self->fp);
-    free(self);
+    _free(self);
 }
 
 void file_writer_write(FileWriter* self, char* string)
@@ -24,7 +24,7 @@ uint64_t hash_string(const char* value)
 StringHashMapElement* new_string_hash_map_element(char* key, uint64_t hash, void* value)
 {
     static_assert(sizeof(StringHashMapElement) == 24, "incomplete construction of StringHashMapElement");
-    StringHashMapElement* self = calloc(1, sizeof(StringHashMapElement));
+    StringHashMapElement* self = _calloc(1, sizeof(StringHashMapElement));
     *self = (StringHashMapElement) {
         .key = key,
         .hash = hash,
@@ -35,15 +35,15 @@ StringHashMapElement* new_string_hash_map_element(char* key, uint64_t hash, void
 
 void delete_string_hash_map_element(StringHashMapElement* self)
 {
-    free(self->key);
-    free(self);
+    _free(self->key);
+    _free(self);
 }
 
 StringHashMap* new_string_hash_map()
 {
     static_assert(sizeof(Map) == 40, "incomplete implementation of Map");
     static_assert(sizeof(StringHashMap) == 56, "incomplete construction of StringHashMap");
-    StringHashMap* self = calloc(1, sizeof(StringHashMap));
+    StringHashMap* self = _calloc(1, sizeof(StringHashMap));
     *self = (StringHashMap) {
         .delete = delete_string_hash_map,
         .length = string_hash_map_length,
@@ -59,7 +59,7 @@ StringHashMap* new_string_hash_map()
 void delete_string_hash_map(StringHashMap* self)
 {
     list_delete_all_and_self(self->m_elements, (void (*)(void*)) delete_string_hash_map_element);
-    free(self);
+    _free(self);
 }
 
 size_t string_hash_map_length(StringHashMap* self)
@@ -76,7 +76,7 @@ Token* new_token(
     const char* value,
     const size_t length)
 {
-    Token* self = calloc(1, sizeof(Token));
+    Token* self = _calloc(1, sizeof(Token));
     *self = (Token) {
         .type = type,
         .value = value,
@@ -87,18 +87,18 @@ Token* new_token(
 
 void delete_token(Token* self)
 {
-    free(self);
+    _free(self);
 }
 
 char* token_to_string(Token* self)
 {
     char* value_str = chars_to_string(self->value, self->length);
 
-    char* buffer = calloc(8192, sizeof(char));
+    char* buffer = _calloc(8192, sizeof(char));
     snprintf(buffer, 8192, "Token(%s, '%s', %ld)", token_type_to_string(self->type), value_str, self->length);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+    buffer = _realloc(buffer, strlen(buffer) * sizeof(char) + 1);
 
-    free(value_str);
+    _free(value_str);
 
     return buffer;
 }
@@ -106,7 +106,7 @@ char* token_to_string(Token* self)
 Lexer* new_lexer(char* text)
 {
     static_assert(sizeof(Lexer) == 16, "incomplete construction of Lexer");
-    Lexer* self = calloc(1, sizeof(Lexer));
+    Lexer* self = _calloc(1, sizeof(Lexer));
     *self = (Lexer) {
         .text = text,
         .index = 0,
@@ -118,7 +118,7 @@ Lexer* new_lexer(char* text)
 
 void delete_lexer(Lexer* self)
 {
-    free(self);
+    _free(self);
 }
 
 static inline bool is_whitespace(const char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
@@ -0,0 +1,223 @@
+#include "utils.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A call site of _calloc or _realloc, frees count toward the site of the
+// block. __FILE__ is a string literal, so file and line are compared by
+// pointer and value.
+typedef struct AllocationSite {
+    const char* func;
+    const char* file;
+    int line;
+    size_t allocations;
+    size_t reallocations;
+    // of the blocks allocated here, wherever they were freed
+    size_t frees;
+    // requested here by calloc and realloc
+    size_t bytes;
+    // of the blocks allocated here, also when a realloc elsewhere resized them
+    size_t live_bytes;
+    size_t live_blocks;
+    size_t peak_live_bytes;
+} AllocationSite;
+
+// In front of every tracked block, so that free finds its site without a
+// lookup. 16 bytes keep the block aligned like malloc's.
+typedef struct AllocationHeader {
+    uint32_t site;
+    uint32_t magic;
+    size_t size;
+} AllocationHeader;
+
+#define ALLOCATION_MAGIC 0xa110ca7e
+
+// Sites are found through an open addressed table with linear probing.
+// Both are allocated with plain calloc so they don't show up in the report.
+typedef struct AllocationTracker {
+    bool registered;
+    size_t sites_length;
+    size_t sites_capacity;
+    AllocationSite* sites;
+    // index + 1 into sites, 0 is empty
+    size_t site_table_capacity;
+    size_t* site_table;
+    size_t live_bytes;
+    size_t peak_live_bytes;
+} AllocationTracker;
+
+static AllocationTracker tracker = { 0 };
+
+static inline size_t hash_site(const char* file, int line)
+{
+    return (size_t) ((((uint64_t) (uintptr_t) file) ^ ((uint64_t) line << 32)) * 0x9E3779B97F4A7C15ull >> 32);
+}
+
+static void print_allocation_report_at_exit()
+{
+    print_allocation_report(stderr);
+}
+
+static void grow_site_table()
+{
+    size_t capacity = tracker.site_table_capacity ? tracker.site_table_capacity * 2 : 256;
+    size_t* table = calloc(capacity, sizeof(size_t));
+    assert(table && "could not allocate allocation site table");
+    for (size_t i = 0; i < tracker.sites_length; i++) {
+        AllocationSite* site = &tracker.sites[i];
+        size_t slot = hash_site(site->file, site->line) & (capacity - 1);
+        while (table[slot])
+            slot = (slot + 1) & (capacity - 1);
+        table[slot] = i + 1;
+    }
+    free(tracker.site_table);
+    tracker.site_table = table;
+    tracker.site_table_capacity = capacity;
+}
+
+static size_t find_or_add_site(const char* func, const char* file, int line)
+{
+    if (!tracker.registered) {
+        atexit(print_allocation_report_at_exit);
+        tracker.registered = true;
+    }
+    if ((tracker.sites_length + 1) * 2 > tracker.site_table_capacity)
+        grow_site_table();
+    size_t mask = tracker.site_table_capacity - 1;
+    size_t slot = hash_site(file, line) & mask;
+    for (; tracker.site_table[slot]; slot = (slot + 1) & mask) {
+        AllocationSite* site = &tracker.sites[tracker.site_table[slot] - 1];
+        if (site->file == file && site->line == line)
+            return tracker.site_table[slot] - 1;
+    }
+    if (tracker.sites_length == tracker.sites_capacity) {
+        tracker.sites_capacity = tracker.sites_capacity ? tracker.sites_capacity * 2 : 128;
+        tracker.sites = realloc(tracker.sites, sizeof(AllocationSite) * tracker.sites_capacity);
+        assert(tracker.sites && "could not allocate allocation sites");
+    }
+    tracker.sites[tracker.sites_length] = (AllocationSite) {
+        .func = func,
+        .file = file,
+        .line = line,
+        .allocations = 0,
+        .reallocations = 0,
+        .frees = 0,
+        .bytes = 0,
+        .live_bytes = 0,
+        .live_blocks = 0,
+        .peak_live_bytes = 0,
+    };
+    tracker.site_table[slot] = tracker.sites_length + 1;
+    return tracker.sites_length++;
+}
+
+static void grow_site_live(AllocationSite* site, size_t old_size, size_t new_size)
+{
+    site->live_bytes = site->live_bytes - old_size + new_size;
+    if (site->live_bytes > site->peak_live_bytes)
+        site->peak_live_bytes = site->live_bytes;
+    tracker.live_bytes = tracker.live_bytes - old_size + new_size;
+    if (tracker.live_bytes > tracker.peak_live_bytes)
+        tracker.peak_live_bytes = tracker.live_bytes;
+}
+
+static AllocationHeader* header_of(void* ptr)
+{
+    AllocationHeader* header = (AllocationHeader*) ptr - 1;
+    assert(header->magic == ALLOCATION_MAGIC && "pointer was not allocated by _calloc or _realloc");
+    return header;
+}
+
+void* tracked_calloc(size_t amount, size_t size, const char* func, const char* file, int line)
+{
+    assert((size == 0 || amount <= (SIZE_MAX - sizeof(AllocationHeader)) / size) && "allocation too large");
+    size_t site_index = find_or_add_site(func, file, line);
+    AllocationSite* site = &tracker.sites[site_index];
+    site->allocations++;
+    site->bytes += amount * size;
+    AllocationHeader* header = calloc(1, sizeof(AllocationHeader) + amount * size);
+    if (!header)
+        return NULL;
+    *header = (AllocationHeader) { .site = site_index, .magic = ALLOCATION_MAGIC, .size = amount * size };
+    site->live_blocks++;
+    grow_site_live(site, 0, amount * size);
+    return header + 1;
+}
+
+void* tracked_realloc(void* ptr, size_t new_size, const char* func, const char* file, int line)
+{
+    if (!ptr)
+        return tracked_calloc(1, new_size, func, file, line);
+    AllocationSite* here = &tracker.sites[find_or_add_site(func, file, line)];
+    here->reallocations++;
+    here->bytes += new_size;
+    size_t old_size = header_of(ptr)->size;
+    AllocationHeader* header = realloc((AllocationHeader*) ptr - 1, sizeof(AllocationHeader) + new_size);
+    if (!header)
+        return NULL;
+    // the block stays with the site that allocated it
+    header->size = new_size;
+    grow_site_live(&tracker.sites[header->site], old_size, new_size);
+    return header + 1;
+}
+
+void tracked_free(void* ptr, const char* func, const char* file, int line)
+{
+    if (!ptr)
+        return;
+    AllocationHeader* header = header_of(ptr);
+    AllocationSite* site = &tracker.sites[header->site];
+    site->frees++;
+    site->live_blocks--;
+    grow_site_live(site, header->size, 0);
+    header->magic = 0;
+    free(header);
+}
+
+static int compare_sites_by_bytes(const void* a, const void* b)
+{
+    const AllocationSite* left = *(const AllocationSite**) a;
+    const AllocationSite* right = *(const AllocationSite**) b;
+    if (left->bytes != right->bytes)
+        return left->bytes < right->bytes ? 1 : -1;
+    return left->line - right->line;
+}
+
+void print_allocation_report(FILE* stream)
+{
+    AllocationSite** sites = calloc(tracker.sites_length + 1, sizeof(AllocationSite*));
+    assert(sites && "could not allocate allocation report");
+    size_t allocations = 0;
+    size_t reallocations = 0;
+    size_t frees = 0;
+    size_t bytes = 0;
+    size_t leaked_blocks = 0;
+    for (size_t i = 0; i < tracker.sites_length; i++) {
+        sites[i] = &tracker.sites[i];
+        allocations += sites[i]->allocations;
+        reallocations += sites[i]->reallocations;
+        frees += sites[i]->frees;
+        bytes += sites[i]->bytes;
+        leaked_blocks += sites[i]->live_blocks;
+    }
+    qsort(sites, tracker.sites_length, sizeof(AllocationSite*), compare_sites_by_bytes);
+
+    fprintf(stream, "=== ALLOCATIONS BY SITE ===\n");
+    fprintf(stream, "%-24s %-32s %8s %8s %8s %12s %12s %12s\n", "site", "function", "allocs", "reallocs", "frees",
+        "bytes", "peak live", "leaked");
+    for (size_t i = 0; i < tracker.sites_length; i++) {
+        AllocationSite* site = sites[i];
+        char location[256];
+        snprintf(location, sizeof(location), "./%s:%d:", site->file, site->line);
+        fprintf(stream, "%-24s %-32s %8zu %8zu %8zu %12zu %12zu %12zu\n", location, site->func, site->allocations,
+            site->reallocations, site->frees, site->bytes, site->peak_live_bytes, site->live_bytes);
+    }
+    fprintf(stream,
+        "%zu allocations, %zu reallocations, %zu frees, %zu bytes, peak %zu live bytes, %zu bytes leaked in %zu "
+        "blocks\n",
+        allocations, reallocations, frees, bytes, tracker.peak_live_bytes, tracker.live_bytes, leaked_blocks);
+    free(sites);
+}
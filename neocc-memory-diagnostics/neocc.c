@@ -34,8 +34,8 @@ int main(int argc, char** argv)
     int linker_exit_code = system("ld temp.o -o a.out");
     assert(linker_exit_code == 0);
 
-    free(assembly);
+    _free(assembly);
     list_delete_all_and_self(ast, (void (*)(void*)) delete_node_inheriter);
     list_delete_all_and_self(tokens, (void (*)(void*)) delete_token);
-    free(content);
+    _free(content);
 }
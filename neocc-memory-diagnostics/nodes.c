@@ -64,7 +64,7 @@ DeclarationNode* new_declaration_node(TypeNode* value_type, Token* target)
 {
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(DeclarationNode) == 40, "incomplete construction of DeclarationNode");
-    DeclarationNode* self = calloc(1, sizeof(DeclarationNode));
+    DeclarationNode* self = _calloc(1, sizeof(DeclarationNode));
     *self = (DeclarationNode) {
         .delete = delete_declaration_node,
         .to_string = declaration_node_to_string,
@@ -79,7 +79,7 @@ void delete_declaration_node(DeclarationNode* self)
 {
     self->value_type->delete (self->value_type);
     delete_token(self->target);
-    free(self);
+    _free(self);
 }
 
 char* declaration_node_to_string(DeclarationNode* self)
@@ -93,8 +93,8 @@ char* declaration_node_to_string(DeclarationNode* self)
     char* result = string_builder_c_string(sb);
     delete_string_builder(sb);
 
-    free(value_type);
-    free(target);
+    _free(value_type);
+    _free(target);
 
     return result;
 }
@@ -111,7 +111,7 @@ char* declaration_nodes_to_string(List* declarations)
         DeclarationNode* node = declarations->get(declarations, i);
         char* node_str = node->to_string(node);
         string_builder_write(declarations_sb, node_str);
-        free(node_str);
+        _free(node_str);
     }
     char* result = string_builder_c_string(declarations_sb);
     delete_string_builder(declarations_sb);
@@ -127,7 +127,7 @@ FuncDefNode* new_func_def_node(
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(StatementNode) == 24, "incomplete implementation of StatementNode");
     static_assert(sizeof(FuncDefNode) == 56, "incomplete construction of FuncDefNode");
-    FuncDefNode* self = calloc(1, sizeof(FuncDefNode));
+    FuncDefNode* self = _calloc(1, sizeof(FuncDefNode));
     *self = (FuncDefNode) {
         .delete = delete_func_def_node,
         .to_string = func_def_node_to_string,
@@ -145,7 +145,7 @@ void delete_func_def_node(FuncDefNode* self)
     self->return_type->delete (self->return_type);
     list_delete_all_and_self(self->params, (void (*)(void*)) delete_node_inheriter);
     list_delete_all_and_self(self->body, (void (*)(void*)) delete_node_inheriter);
-    free(self);
+    _free(self);
 }
 
 char* func_def_node_to_string(FuncDefNode* self)
@@ -155,7 +155,7 @@ char* func_def_node_to_string(FuncDefNode* self)
     char* return_type = self->return_type->to_string(self->return_type);
     char* params = "<unimplemented>";
 
-    char* body = calloc(8192, sizeof(char));
+    char* body = _calloc(8192, sizeof(char));
     bool first = true;
     for (int i = 0; i < self->body->length(self->body); i++) {
         StatementNode* statement = self->body->get(self->body, i);
@@ -165,16 +165,16 @@ char* func_def_node_to_string(FuncDefNode* self)
         else
             first = false;
         strcat(body, str);
-        free(str);
+        _free(str);
     }
 
-    char* buffer = calloc(8192, sizeof(char));
+    char* buffer = _calloc(8192, sizeof(char));
     sprintf(buffer, "%s {target: %s, return_type: %s, params: [%s], body: [%s]}", type, target, return_type, params, body);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+    buffer = _realloc(buffer, strlen(buffer) * sizeof(char) + 1);
 
-    free(target);
-    free(return_type);
-    free(body);
+    _free(target);
+    _free(return_type);
+    _free(body);
 
     return buffer;
 }
@@ -184,7 +184,7 @@ ReturnNode* new_return_node(ExpressionNode* value)
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(StatementNode) == 24, "incomplete implementation of StatementNode");
     static_assert(sizeof(ReturnNode) == 32, "incomplete construction of ReturnNode");
-    ReturnNode* self = calloc(1, sizeof(ReturnNode));
+    ReturnNode* self = _calloc(1, sizeof(ReturnNode));
     *self = (ReturnNode) {
         .delete = delete_return_node,
         .to_string = return_node_to_string,
@@ -197,7 +197,7 @@ ReturnNode* new_return_node(ExpressionNode* value)
 void delete_return_node(ReturnNode* self)
 {
     self->value->delete (self->value);
-    free(self);
+    _free(self);
 }
 
 char* return_node_to_string(ReturnNode* self)
@@ -205,11 +205,11 @@ char* return_node_to_string(ReturnNode* self)
     const char* type = statement_node_type_to_string(self->node_type);
     char* value = self->value->to_string(self->value);
 
-    char* buffer = calloc(8192, sizeof(char));
+    char* buffer = _calloc(8192, sizeof(char));
     sprintf(buffer, "%s {value: %s}", type, value);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+    buffer = _realloc(buffer, strlen(buffer) * sizeof(char) + 1);
 
-    free(value);
+    _free(value);
 
     return buffer;
 }
@@ -219,7 +219,7 @@ Initialization* new_initialization_node(TypeNode* value_type, Token* target, Exp
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(DeclarationNode) == 40, "incomplete implementation of DeclarationNode");
     static_assert(sizeof(Initialization) == 48, "incomplete construction of Initialization");
-    Initialization* self = calloc(1, sizeof(Initialization));
+    Initialization* self = _calloc(1, sizeof(Initialization));
     *self = (Initialization) {
         .delete = delete_initialization_node,
         .to_string = initialization_node_to_string,
@@ -236,7 +236,7 @@ void delete_initialization_node(Initialization* self)
     self->value_type->delete (self->value_type);
     delete_token(self->target);
     self->value->delete (self->value);
-    free(self);
+    _free(self);
 }
 
 char* initialization_node_to_string(Initialization* self)
@@ -251,9 +251,9 @@ char* initialization_node_to_string(Initialization* self)
     char* result = string_builder_c_string(sb);
     delete_string_builder(sb);
 
-    free(value_type);
-    free(target);
-    free(value);
+    _free(value_type);
+    _free(target);
+    _free(value);
 
     return result;
 }
@@ -263,7 +263,7 @@ DeclStmtNode* new_declaration_statement_node(List* declarations)
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(StatementNode) == 24, "incomplete implementation of StatementNode");
     static_assert(sizeof(DeclStmtNode) == 32, "incomplete construction of DeclStmtNode");
-    DeclStmtNode* self = calloc(1, sizeof(DeclStmtNode));
+    DeclStmtNode* self = _calloc(1, sizeof(DeclStmtNode));
     *self = (DeclStmtNode) {
         .delete = delete_declaration_statement_node,
         .to_string = declaration_statement_node_to_string,
@@ -276,7 +276,7 @@ DeclStmtNode* new_declaration_statement_node(List* declarations)
 void delete_declaration_statement_node(DeclStmtNode* self)
 {
     list_delete_all_and_self(self->declarations, (void (*)(void*)) delete_node_inheriter);
-    free(self);
+    _free(self);
 }
 
 char* declaration_statement_node_to_string(DeclStmtNode* self)
@@ -289,7 +289,7 @@ char* declaration_statement_node_to_string(DeclStmtNode* self)
     char* result = string_builder_c_string(sb);
     delete_string_builder(sb);
 
-    free(declarations);
+    _free(declarations);
     return result;
 }
 
@@ -298,7 +298,7 @@ ExprStmtNode* new_expression_statement_node(ExpressionNode* value)
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(StatementNode) == 24, "incomplete implementation of StatementNode");
     static_assert(sizeof(ExprStmtNode) == 32, "incomplete construction of ExprStmtNode");
-    ExprStmtNode* self = calloc(1, sizeof(ExprStmtNode));
+    ExprStmtNode* self = _calloc(1, sizeof(ExprStmtNode));
     *self = (ExprStmtNode) {
         .delete = delete_expression_statement_node,
         .to_string = expression_statement_to_string,
@@ -311,7 +311,7 @@ ExprStmtNode* new_expression_statement_node(ExpressionNode* value)
 void delete_expression_statement_node(ExprStmtNode* self)
 {
     self->value->delete (self->value);
-    free(self);
+    _free(self);
 }
 
 char* expression_statement_to_string(ExprStmtNode* self)
@@ -319,11 +319,11 @@ char* expression_statement_to_string(ExprStmtNode* self)
     const char* type = statement_node_type_to_string(self->node_type);
     char* value = self->value->to_string(self->value);
 
-    char* buffer = calloc(8192, sizeof(char));
+    char* buffer = _calloc(8192, sizeof(char));
     sprintf(buffer, "%s {value: %s}", type, value);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+    buffer = _realloc(buffer, strlen(buffer) * sizeof(char) + 1);
 
-    free(value);
+    _free(value);
 
     return buffer;
 }
@@ -333,7 +333,7 @@ KeywordTypeNode* new_keyword_type_node(Token* token)
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(TypeNode) == 24, "incomplete implementation of TypeNode");
     static_assert(sizeof(KeywordTypeNode) == 32, "incomplete construction of KeywordTypeNode");
-    KeywordTypeNode* self = calloc(1, sizeof(KeywordTypeNode));
+    KeywordTypeNode* self = _calloc(1, sizeof(KeywordTypeNode));
     *self = (KeywordTypeNode) {
         .delete = delete_keyword_type_node,
         .to_string = keyword_type_node_to_string,
@@ -345,7 +345,7 @@ KeywordTypeNode* new_keyword_type_node(Token* token)
 
 void delete_keyword_type_node(KeywordTypeNode* self)
 {
-    free(self);
+    _free(self);
 }
 
 char* keyword_type_node_to_string(KeywordTypeNode* self)
@@ -353,11 +353,11 @@ char* keyword_type_node_to_string(KeywordTypeNode* self)
     const char* type = type_node_type_to_string(self->node_type);
     char* token = token_to_string(self->token);
 
-    char* buffer = calloc(8192, sizeof(char));
+    char* buffer = _calloc(8192, sizeof(char));
     sprintf(buffer, "%s {value: %s}", type, token);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+    buffer = _realloc(buffer, strlen(buffer) * sizeof(char) + 1);
 
-    free(token);
+    _free(token);
 
     return buffer;
 }
@@ -376,7 +376,7 @@ AssignmentNode* new_assignment_node(AssignmentType asignment_type, Token* target
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(ExpressionNode) == 24, "incomplete implementation of ExpressionNode");
     static_assert(sizeof(AssignmentNode) == 40, "incomplete construction of AssignmentNode");
-    AssignmentNode* self = calloc(1, sizeof(AssignmentNode));
+    AssignmentNode* self = _calloc(1, sizeof(AssignmentNode));
     *self = (AssignmentNode) {
         .delete = delete_assignment_node,
         .to_string = assignment_node_to_string,
@@ -392,7 +392,7 @@ void delete_assignment_node(AssignmentNode* self)
 {
     delete_token(self->target);
     self->value->delete (self->value);
-    free(self);
+    _free(self);
 }
 
 char* assignment_node_to_string(AssignmentNode* self)
@@ -406,8 +406,8 @@ char* assignment_node_to_string(AssignmentNode* self)
     char* result = string_builder_c_string(sb);
     delete_string_builder(sb);
 
-    free(target);
-    free(value);
+    _free(target);
+    _free(value);
     return result;
 }
 
@@ -425,7 +425,7 @@ BinaryOperationNode* new_binary_operation_node(BinaryOperationType operation_typ
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(ExpressionNode) == 24, "incomplete implementation of ExpressionNode");
     static_assert(sizeof(BinaryOperationNode) == 40, "incomplete construction of BinaryOperationNode");
-    BinaryOperationNode* self = calloc(1, sizeof(BinaryOperationNode));
+    BinaryOperationNode* self = _calloc(1, sizeof(BinaryOperationNode));
     *self = (BinaryOperationNode) {
         .delete = delete_binary_operation_node,
         .to_string = binary_operation_to_string,
@@ -441,7 +441,7 @@ void delete_binary_operation_node(BinaryOperationNode* self)
 {
     self->left->delete (self->left);
     self->right->delete (self->right);
-    free(self);
+    _free(self);
 }
 
 char* binary_operation_to_string(BinaryOperationNode* self)
@@ -456,8 +456,8 @@ char* binary_operation_to_string(BinaryOperationNode* self)
     char* result = string_builder_c_string(sb);
     delete_string_builder(sb);
 
-    free(left);
-    free(right);
+    _free(left);
+    _free(right);
     return result;
 }
 
@@ -466,7 +466,7 @@ SymbolNode* new_symbol_node(Token* token)
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(ExpressionNode) == 24, "incomplete implementation of ExpressionNode");
     static_assert(sizeof(SymbolNode) == 32, "incomplete construction of SymbolNode");
-    SymbolNode* self = calloc(1, sizeof(SymbolNode));
+    SymbolNode* self = _calloc(1, sizeof(SymbolNode));
     *self = (SymbolNode) {
         .delete = delete_symbol_node,
         .to_string = symbol_node_to_string,
@@ -478,7 +478,7 @@ SymbolNode* new_symbol_node(Token* token)
 
 void delete_symbol_node(SymbolNode* self)
 {
-    free(self);
+    _free(self);
 }
 
 char* symbol_node_to_string(SymbolNode* self)
@@ -486,11 +486,11 @@ char* symbol_node_to_string(SymbolNode* self)
     const char* type = expression_node_type_to_string(self->node_type);
     char* token = token_to_string(self->token);
 
-    char* buffer = calloc(8192, sizeof(char));
+    char* buffer = _calloc(8192, sizeof(char));
     sprintf(buffer, "%s {token: %s}", type, token);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+    buffer = _realloc(buffer, strlen(buffer) * sizeof(char) + 1);
 
-    free(token);
+    _free(token);
 
     return buffer;
 }
@@ -500,7 +500,7 @@ IntNode* new_int_node(Token* token)
     static_assert(sizeof(Node) == 16, "incomplete implementation of Node");
     static_assert(sizeof(ExpressionNode) == 24, "incomplete implementation of ExpressionNode");
     static_assert(sizeof(IntNode) == 32, "incomplete construction of IntNode");
-    IntNode* self = calloc(1, sizeof(IntNode));
+    IntNode* self = _calloc(1, sizeof(IntNode));
     *self = (IntNode) {
         .delete = delete_int_node,
         .to_string = int_node_to_string,
@@ -512,7 +512,7 @@ IntNode* new_int_node(Token* token)
 
 void delete_int_node(IntNode* self)
 {
-    free(self);
+    _free(self);
 }
 
 char* int_node_to_string(IntNode* self)
@@ -520,11 +520,11 @@ char* int_node_to_string(IntNode* self)
     const char* type = expression_node_type_to_string(self->node_type);
     char* token = token_to_string(self->token);
 
-    char* buffer = calloc(8192, sizeof(char));
+    char* buffer = _calloc(8192, sizeof(char));
     sprintf(buffer, "%s {token: %s}", type, token);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+    buffer = _realloc(buffer, strlen(buffer) * sizeof(char) + 1);
 
-    free(token);
+    _free(token);
 
     return buffer;
 }
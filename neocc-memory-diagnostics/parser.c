@@ -7,7 +7,7 @@
 
 Parser* new_parser(List* tokens)
 {
-    Parser* self = calloc(1, sizeof(Parser));
+    Parser* self = _calloc(1, sizeof(Parser));
     *self = (Parser) {
         .tokens = tokens,
         .index = 0,
@@ -19,7 +19,7 @@ Parser* new_parser(List* tokens)
 
 void delete_parser(Parser* self)
 {
-    free(self);
+    _free(self);
 }
 
 List* parser_parse(Parser* self)
@@ -183,6 +183,6 @@ List* parse(List* tokens)
 {
     Parser* parser = new_parser(tokens);
     List* ast = parser_parse(parser);
-    free(parser);
+    _free(parser);
     return ast;
 }
@@ -8,18 +8,18 @@
 StringBuilder* new_string_builder()
 {
     static_assert(sizeof(StringBuilder) == 16, "incomplete construction of StringBuilder");
-    StringBuilder* self = calloc(1, sizeof(StringBuilder));
+    StringBuilder* self = _calloc(1, sizeof(StringBuilder));
     *self = (StringBuilder) {
         .m_length = 0,
-        .m_buffer = calloc(1, sizeof(char)),
+        .m_buffer = _calloc(1, sizeof(char)),
     };
     return self;
 }
 
 void delete_string_builder(StringBuilder* self)
 {
-    free(self->m_buffer);
-    free(self);
+    _free(self->m_buffer);
+    _free(self);
 }
 
 size_t string_builder_length(StringBuilder* self)
@@ -29,7 +29,7 @@ size_t string_builder_length(StringBuilder* self)
 
 char* string_builder_c_string(StringBuilder* self)
 {
-    char* buffer = calloc(1, self->m_length * sizeof(char) + 1);
+    char* buffer = _calloc(1, self->m_length * sizeof(char) + 1);
     memcpy(buffer, self->m_buffer, self->m_length);
     return buffer;
 }
@@ -43,7 +43,7 @@ void string_builder_write(StringBuilder* self, char* string)
 {
     size_t old_length = self->m_length;
     self->m_length += strlen(string);
-    self->m_buffer = realloc(self->m_buffer, self->m_length * sizeof(char) + 1);
+    self->m_buffer = _realloc(self->m_buffer, self->m_length * sizeof(char) + 1);
     memset(self->m_buffer + sizeof(char) * old_length, '\0', self->m_length - old_length);
     strcat(self->m_buffer, string);
 }
@@ -17,12 +17,12 @@ void list_delete_all_and_self(List* list, void (*deletor)(void *))
 void println_and_free(char* string)
 {
     printf("%s\n", string);
-    free(string);
+    _free(string);
 }
 
 char* chars_to_string(const char* chars, size_t amount)
 {
-    char* buffer = calloc(amount + 1, sizeof(char));
+    char* buffer = _calloc(amount + 1, sizeof(char));
     strncpy(buffer, chars, amount);
     return buffer;
 }
@@ -30,7 +30,7 @@ char* chars_to_string(const char* chars, size_t amount)
 char* copy_string(const char* string)
 {
     size_t length = strlen(string);
-    char* copy = calloc(length + 1, sizeof(char));
+    char* copy = _calloc(length + 1, sizeof(char));
     strncpy(copy, string, length);
     return copy;
 }
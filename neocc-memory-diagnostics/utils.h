@@ -108,3 +108,21 @@ void println_and_free(char* string);
 void list_delete_all_and_self(List* list, void (*)(void*));
 char* read_file(const char* path);
 void write_file(const char* path, char* string);
+
+// Built with -DMEMORY_DIAGNOSTICS every allocation is recorded by call site,
+// and the counts, bytes, peak live bytes and leaks of each site are printed
+// to stderr at exit. Otherwise these are the plain libc functions.
+#ifdef MEMORY_DIAGNOSTICS
+#define _calloc(amount, size) tracked_calloc(amount, size, __FUNCTION__, __FILE__, __LINE__)
+#define _realloc(ptr, new_size) tracked_realloc(ptr, new_size, __FUNCTION__, __FILE__, __LINE__)
+#define _free(ptr) tracked_free(ptr, __FUNCTION__, __FILE__, __LINE__)
+#else
+#define _calloc(amount, size) calloc(amount, size)
+#define _realloc(ptr, new_size) realloc(ptr, new_size)
+#define _free(ptr) free(ptr)
+#endif
+
+void* tracked_calloc(size_t amount, size_t size, const char* func, const char* file, int line);
+void* tracked_realloc(void* ptr, size_t new_size, const char* func, const char* file, int line);
+void tracked_free(void* ptr, const char* func, const char* file, int line);
+void print_allocation_report(FILE* stream);
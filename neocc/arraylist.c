@@ -4,11 +4,13 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#define ARRAY_LIST_MIN_CAPACITY 8
+
 ArrayList* new_array_list()
 {
     static_assert(sizeof(List) == 48, "incomplete implementation of List");
-    static_assert(sizeof(ArrayList) == 64, "incomplete construction of ArrayList");
-    ArrayList* self = calloc(1, sizeof(ArrayList));
+    static_assert(sizeof(ArrayList) == 72, "incomplete construction of ArrayList");
+    ArrayList* self = counted_calloc(1, sizeof(ArrayList));
     *self = (ArrayList) {
         .delete = delete_array_list,
         .length = array_list_length,
@@ -17,6 +19,7 @@ ArrayList* new_array_list()
         .free_all = array_list_free_all,
         .delete_all = array_list_delete_all,
         .m_length = 0,
+        .m_capacity = 0,
         .m_elements = NULL,
     };
     return self;
@@ -41,11 +44,30 @@ void* array_list_get(ArrayList* self, int index)
     return self->m_elements[index];
 }
 
+static void array_list_set_capacity(ArrayList* self, size_t capacity)
+{
+    self->m_elements = counted_realloc(self->m_elements, sizeof(void*) * capacity);
+    assert((self->m_elements || capacity == 0) && "could not allocate list elements");
+    self->m_capacity = capacity;
+}
+
 void array_list_add(ArrayList* self, void* element)
 {
-    self->m_length++;
-    self->m_elements = realloc(self->m_elements, sizeof(void*) * self->m_length);
-    self->m_elements[self->m_length - 1] = element;
+    if (self->m_length == self->m_capacity)
+        array_list_set_capacity(self, self->m_capacity ? self->m_capacity * 2 : ARRAY_LIST_MIN_CAPACITY);
+    self->m_elements[self->m_length++] = element;
+}
+
+void array_list_reserve(ArrayList* self, size_t capacity)
+{
+    if (capacity > self->m_capacity)
+        array_list_set_capacity(self, capacity);
+}
+
+void array_list_shrink_to_fit(ArrayList* self)
+{
+    if (self->m_length < self->m_capacity)
+        array_list_set_capacity(self, self->m_length);
 }
 
 void array_list_free_all(ArrayList* self)
@@ -0,0 +1,717 @@
+#include "assembly.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ASSEMBLY_MIN_CAPACITY 64
+
+const char* register_to_string(Register reg, int size)
+{
+    static const char* names_64[] = {
+        "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+        "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15",
+    };
+    static const char* names_32[] = {
+        "%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi",
+        "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d",
+    };
+    static const char* names_8[] = {
+        "%al", "%cl", "%dl", "%bl", "%spl", "%bpl", "%sil", "%dil",
+        "%r8b", "%r9b", "%r10b", "%r11b", "%r12b", "%r13b", "%r14b", "%r15b",
+    };
+    return size == 8 ? names_64[reg] : size == 1 ? names_8[reg] : names_32[reg];
+}
+
+const char* opcode_to_string(Opcode opcode)
+{
+    switch (opcode) {
+    case OPCODE_LABEL:
+        return "label";
+    case OPCODE_MOV:
+        return "mov";
+    case OPCODE_ADD:
+        return "add";
+    case OPCODE_SUB:
+        return "sub";
+    case OPCODE_IMUL:
+        return "imul";
+    case OPCODE_IDIV:
+        return "idiv";
+    case OPCODE_CLTD:
+        return "cltd";
+    case OPCODE_AND:
+        return "and";
+    case OPCODE_OR:
+        return "or";
+    case OPCODE_XOR:
+        return "xor";
+    case OPCODE_CMP:
+        return "cmp";
+    case OPCODE_SHL:
+        return "shl";
+    case OPCODE_SAR:
+        return "sar";
+    case OPCODE_SETE:
+        return "sete";
+    case OPCODE_SETNE:
+        return "setne";
+    case OPCODE_SETL:
+        return "setl";
+    case OPCODE_SETLE:
+        return "setle";
+    case OPCODE_SETG:
+        return "setg";
+    case OPCODE_SETGE:
+        return "setge";
+    case OPCODE_MOVZB:
+        return "movzb";
+    case OPCODE_PUSH:
+        return "push";
+    case OPCODE_POP:
+        return "pop";
+    case OPCODE_CALL:
+        return "call";
+    case OPCODE_JMP:
+        return "jmp";
+    case OPCODE_JNE:
+        return "jne";
+    case OPCODE_RET:
+        return "ret";
+    case OPCODE_INT:
+        return "int";
+    }
+    assert(!"unreachable");
+}
+
+Operand operand_none()
+{
+    return (Operand) { .type = OPERAND_TYPE_NONE };
+}
+
+Operand operand_register(Register reg)
+{
+    return (Operand) { .type = OPERAND_TYPE_REGISTER, .reg = reg };
+}
+
+Operand operand_immediate(int64_t value)
+{
+    return (Operand) { .type = OPERAND_TYPE_IMMEDIATE, .value = value };
+}
+
+Operand operand_memory(Register base, int32_t displacement)
+{
+    return (Operand) { .type = OPERAND_TYPE_MEMORY, .reg = base, .value = displacement };
+}
+
+Operand operand_label(int label)
+{
+    return (Operand) { .type = OPERAND_TYPE_LABEL, .value = label };
+}
+
+Assembly* new_assembly()
+{
+    static_assert(sizeof(Instruction) == 40, "incomplete construction of Instruction");
+    static_assert(sizeof(Assembly) == 40, "incomplete construction of Assembly");
+    Assembly* self = counted_calloc(1, sizeof(Assembly));
+    *self = (Assembly) {
+        .m_length = 0,
+        .m_capacity = 0,
+        .m_instructions = NULL,
+        .m_label_names = (List*) new_array_list(),
+        .m_label_ids = new_string_hash_map(),
+    };
+    return self;
+}
+
+void delete_assembly(Assembly* self)
+{
+    free(self->m_instructions);
+    list_free_all_and_self(self->m_label_names);
+    delete_string_hash_map(self->m_label_ids);
+    free(self);
+}
+
+size_t assembly_length(Assembly* self)
+{
+    return self->m_length;
+}
+
+Instruction* assembly_get(Assembly* self, size_t index)
+{
+    assert(index < self->m_length && "index out of range");
+    return &self->m_instructions[index];
+}
+
+void assembly_add(Assembly* self, Opcode opcode, int size, Operand source, Operand destination)
+{
+    if (self->m_length == self->m_capacity) {
+        self->m_capacity = self->m_capacity ? self->m_capacity * 2 : ASSEMBLY_MIN_CAPACITY;
+        self->m_instructions = counted_realloc(self->m_instructions, sizeof(Instruction) * self->m_capacity);
+        assert(self->m_instructions && "could not allocate instructions");
+    }
+    self->m_instructions[self->m_length++] = (Instruction) {
+        .opcode = opcode,
+        .size = size,
+        .source = source,
+        .destination = destination,
+    };
+}
+
+void assembly_truncate(Assembly* self, size_t length)
+{
+    assert(length <= self->m_length && "truncating to a longer length");
+    self->m_length = length;
+}
+
+static inline Operand remap_label(Operand operand, const int* labels)
+{
+    if (operand.type == OPERAND_TYPE_LABEL)
+        operand.value = labels[operand.value];
+    return operand;
+}
+
+void assembly_append(Assembly* self, Assembly* other)
+{
+    size_t labels_length = other->m_label_names->length(other->m_label_names);
+    int* labels = counted_calloc(labels_length + 1, sizeof(int));
+    for (size_t i = 0; i < labels_length; i++)
+        labels[i] = assembly_label(self, assembly_label_name(other, i));
+    for (size_t i = 0; i < other->m_length; i++) {
+        Instruction* instruction = &other->m_instructions[i];
+        assembly_add(self, instruction->opcode, instruction->size, remap_label(instruction->source, labels),
+            remap_label(instruction->destination, labels));
+    }
+    free(labels);
+}
+
+int assembly_label(Assembly* self, const char* name)
+{
+    StringHashMapElement* existing = string_hash_map_find(self->m_label_ids, name, strlen(name));
+    if (existing)
+        return (int) (intptr_t) existing->value;
+    int label = self->m_label_names->length(self->m_label_names);
+    self->m_label_names->add(self->m_label_names, copy_string(name));
+    string_hash_map_set(self->m_label_ids, name, (void*) (intptr_t) label);
+    return label;
+}
+
+const char* assembly_label_name(Assembly* self, int label)
+{
+    return self->m_label_names->get(self->m_label_names, label);
+}
+
+size_t assembly_labels_length(Assembly* self)
+{
+    return self->m_label_names->length(self->m_label_names);
+}
+
+void assembly_place_label(Assembly* self, int label)
+{
+    assembly_add(self, OPCODE_LABEL, 0, operand_label(label), operand_none());
+}
+
+static void write_operand(Assembly* self, StringBuilder* sb, Operand* operand, int size)
+{
+    switch (operand->type) {
+    case OPERAND_TYPE_REGISTER:
+        string_builder_write(sb, register_to_string(operand->reg, size));
+        break;
+    case OPERAND_TYPE_IMMEDIATE:
+        string_builder_write_fmt(sb, "$%ld", operand->value);
+        break;
+    case OPERAND_TYPE_MEMORY:
+        string_builder_write_fmt(sb, "%ld(%s)", operand->value, register_to_string(operand->reg, 8));
+        break;
+    case OPERAND_TYPE_LABEL:
+        string_builder_write(sb, assembly_label_name(self, operand->value));
+        break;
+    case OPERAND_TYPE_NONE:
+        assert(!"unexpected empty operand");
+    }
+}
+
+static inline bool has_size_suffix(Opcode opcode)
+{
+    switch (opcode) {
+    case OPCODE_MOV:
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_IMUL:
+    case OPCODE_IDIV:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_CMP:
+    case OPCODE_SHL:
+    case OPCODE_SAR:
+    case OPCODE_MOVZB:
+    case OPCODE_PUSH:
+    case OPCODE_POP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The byte register source of movzb and of shifts by %cl is written at
+// its byte size.
+static inline int source_size(Instruction* instruction)
+{
+    bool byte_source = instruction->opcode == OPCODE_MOVZB || instruction->opcode == OPCODE_SHL
+        || instruction->opcode == OPCODE_SAR;
+    return byte_source && instruction->source.type == OPERAND_TYPE_REGISTER ? 1 : instruction->size;
+}
+
+char* assembly_to_string(Assembly* self)
+{
+    StringBuilder* sb = new_string_builder();
+    string_builder_write(sb, ".global _start\n");
+    string_builder_write(sb, ".text\n");
+    for (size_t i = 0; i < self->m_length; i++) {
+        Instruction* instruction = &self->m_instructions[i];
+        if (instruction->opcode == OPCODE_LABEL) {
+            string_builder_write(sb, assembly_label_name(self, instruction->source.value));
+            string_builder_write(sb, ":\n");
+            continue;
+        }
+        string_builder_write(sb, "    ");
+        string_builder_write(sb, opcode_to_string(instruction->opcode));
+        if (has_size_suffix(instruction->opcode))
+            string_builder_write_char(sb, instruction->size == 8 ? 'q' : 'l');
+        if (instruction->source.type != OPERAND_TYPE_NONE) {
+            string_builder_write_char(sb, ' ');
+            write_operand(self, sb, &instruction->source, source_size(instruction));
+        }
+        if (instruction->destination.type != OPERAND_TYPE_NONE) {
+            string_builder_write(sb, ", ");
+            write_operand(self, sb, &instruction->destination, instruction->size);
+        }
+        string_builder_write_char(sb, '\n');
+    }
+    char* result = string_builder_take(sb);
+    delete_string_builder(sb);
+    return result;
+}
+
+#define ASSEMBLY_BYTES_MAGIC "neoccasm"
+
+void assembly_write(Assembly* self, StringBuilder* bytes)
+{
+    uint64_t labels_length = self->m_label_names->length(self->m_label_names);
+    uint64_t instructions_length = self->m_length;
+    string_builder_write_n(bytes, ASSEMBLY_BYTES_MAGIC, 8);
+    string_builder_write_n(bytes, (const char*) &labels_length, sizeof(labels_length));
+    string_builder_write_n(bytes, (const char*) &instructions_length, sizeof(instructions_length));
+    for (uint64_t i = 0; i < labels_length; i++) {
+        // with its terminator
+        const char* name = assembly_label_name(self, i);
+        string_builder_write_n(bytes, name, strlen(name) + 1);
+    }
+    string_builder_write_n(bytes, (const char*) self->m_instructions, sizeof(Instruction) * self->m_length);
+}
+
+Assembly* new_assembly_from_bytes(const char* bytes, size_t length)
+{
+    uint64_t labels_length, instructions_length;
+    if (length < 24 || memcmp(bytes, ASSEMBLY_BYTES_MAGIC, 8) != 0)
+        return NULL;
+    memcpy(&labels_length, bytes + 8, sizeof(labels_length));
+    memcpy(&instructions_length, bytes + 16, sizeof(instructions_length));
+    const char* end = bytes + length;
+    const char* names = bytes + 24;
+
+    // labels are created in order, so their ids stay the same
+    Assembly* self = new_assembly();
+    for (uint64_t i = 0; i < labels_length; i++) {
+        const char* terminator = memchr(names, '\0', end - names);
+        if (!terminator) {
+            delete_assembly(self);
+            return NULL;
+        }
+        assembly_label(self, names);
+        names = terminator + 1;
+    }
+    if ((size_t) (end - names) != sizeof(Instruction) * instructions_length) {
+        delete_assembly(self);
+        return NULL;
+    }
+    self->m_capacity = instructions_length;
+    self->m_length = instructions_length;
+    self->m_instructions = counted_malloc(sizeof(Instruction) * instructions_length + 1);
+    memcpy(self->m_instructions, names, sizeof(Instruction) * instructions_length);
+    return self;
+}
+
+typedef struct Encoder {
+    StringBuilder* bytes;
+    size_t* label_offsets;
+    // where every instruction starts
+    size_t* instruction_offsets;
+    // the next jmp or jne is encoded with a rel8
+    bool short_jump;
+    // (offset of rel32 or rel8, its width, label) triples, patched when
+    // every label is placed
+    size_t* fixups;
+    size_t fixups_length;
+    size_t fixups_capacity;
+} Encoder;
+
+static inline void emit_byte(Encoder* encoder, uint8_t byte)
+{
+    string_builder_write_char(encoder->bytes, (char) byte);
+}
+
+static inline void emit_int32(Encoder* encoder, int32_t value)
+{
+    string_builder_write_n(encoder->bytes, (const char*) &value, sizeof(value));
+}
+
+static inline void emit_int64(Encoder* encoder, int64_t value)
+{
+    string_builder_write_n(encoder->bytes, (const char*) &value, sizeof(value));
+}
+
+static inline bool fits_int8(int64_t value) { return value >= INT8_MIN && value <= INT8_MAX; }
+static inline bool fits_int32(int64_t value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+// REX prefix for an instruction whose ModRM reg field is reg and whose
+// ModRM rm field (or opcode register) is rm, only emitted when needed.
+static void emit_rex(Encoder* encoder, int size, int reg, int rm)
+{
+    uint8_t rex = 0x40 | (size == 8) << 3 | (reg >= 8) << 2 | (rm >= 8);
+    if (rex != 0x40)
+        emit_byte(encoder, rex);
+}
+
+// ModRM (and SIB and displacement) with reg in the reg field and operand
+// as the register or memory rm field.
+static void emit_modrm(Encoder* encoder, int reg, Operand* operand)
+{
+    if (operand->type == OPERAND_TYPE_REGISTER) {
+        emit_byte(encoder, 0xc0 | (reg & 7) << 3 | (operand->reg & 7));
+        return;
+    }
+    assert(operand->type == OPERAND_TYPE_MEMORY && "expected register or memory operand");
+    int base = operand->reg & 7;
+    int64_t displacement = operand->value;
+    // rbp and r13 as base can't be encoded without a displacement
+    int mod = displacement == 0 && base != REGISTER_RBP ? 0 : fits_int8(displacement) ? 1 : 2;
+    emit_byte(encoder, mod << 6 | (reg & 7) << 3 | base);
+    // rsp and r12 as base require a SIB byte
+    if (base == REGISTER_RSP)
+        emit_byte(encoder, 0x24);
+    if (mod == 1)
+        emit_byte(encoder, (uint8_t) displacement);
+    else if (mod == 2)
+        emit_int32(encoder, (int32_t) displacement);
+}
+
+static void emit_label_reference(Encoder* encoder, int label, int width)
+{
+    if (encoder->fixups_length == encoder->fixups_capacity) {
+        encoder->fixups_capacity = encoder->fixups_capacity ? encoder->fixups_capacity * 2 : 16;
+        encoder->fixups = counted_realloc(encoder->fixups, sizeof(size_t) * 3 * encoder->fixups_capacity);
+    }
+    encoder->fixups[encoder->fixups_length * 3] = string_builder_length(encoder->bytes);
+    encoder->fixups[encoder->fixups_length * 3 + 1] = width;
+    encoder->fixups[encoder->fixups_length * 3 + 2] = label;
+    encoder->fixups_length++;
+    if (width == 1)
+        emit_byte(encoder, 0);
+    else
+        emit_int32(encoder, 0);
+}
+
+// add, sub, and, or, xor and cmp share their encoding, only the opcodes
+// and /digit differ.
+static void encode_arithmetic(Encoder* encoder, Instruction* instruction, uint8_t rm_reg, uint8_t reg_rm, int digit)
+{
+    Operand* source = &instruction->source;
+    Operand* destination = &instruction->destination;
+    if (source->type == OPERAND_TYPE_IMMEDIATE && fits_int8(source->value)) {
+        // sign extended 8 bit immediate
+        emit_rex(encoder, instruction->size, 0, destination->reg);
+        emit_byte(encoder, 0x83);
+        emit_modrm(encoder, digit, destination);
+        emit_byte(encoder, (uint8_t) source->value);
+    } else if (source->type == OPERAND_TYPE_IMMEDIATE) {
+        assert(fits_int32(source->value) && "immediate out of range");
+        emit_rex(encoder, instruction->size, 0, destination->reg);
+        emit_byte(encoder, 0x81);
+        emit_modrm(encoder, digit, destination);
+        emit_int32(encoder, (int32_t) source->value);
+    } else if (source->type == OPERAND_TYPE_REGISTER) {
+        emit_rex(encoder, instruction->size, source->reg, destination->reg);
+        emit_byte(encoder, rm_reg);
+        emit_modrm(encoder, source->reg, destination);
+    } else {
+        assert(destination->type == OPERAND_TYPE_REGISTER && "expected register destination");
+        emit_rex(encoder, instruction->size, destination->reg, source->reg);
+        emit_byte(encoder, reg_rm);
+        emit_modrm(encoder, destination->reg, source);
+    }
+}
+
+static void encode_mov(Encoder* encoder, Instruction* instruction)
+{
+    Operand* source = &instruction->source;
+    Operand* destination = &instruction->destination;
+    if (source->type == OPERAND_TYPE_IMMEDIATE && destination->type == OPERAND_TYPE_REGISTER
+        && (instruction->size == 4 || !fits_int32(source->value))) {
+        // mov $imm, %reg with the full operand size immediate
+        emit_rex(encoder, instruction->size, 0, destination->reg);
+        emit_byte(encoder, 0xb8 + (destination->reg & 7));
+        if (instruction->size == 8)
+            emit_int64(encoder, source->value);
+        else
+            emit_int32(encoder, (int32_t) source->value);
+    } else if (source->type == OPERAND_TYPE_IMMEDIATE) {
+        // sign extended 32 bit immediate
+        assert(fits_int32(source->value) && "immediate out of range");
+        emit_rex(encoder, instruction->size, 0, destination->reg);
+        emit_byte(encoder, 0xc7);
+        emit_modrm(encoder, 0, destination);
+        emit_int32(encoder, (int32_t) source->value);
+    } else if (source->type == OPERAND_TYPE_REGISTER) {
+        emit_rex(encoder, instruction->size, source->reg, destination->reg);
+        emit_byte(encoder, 0x89);
+        emit_modrm(encoder, source->reg, destination);
+    } else {
+        assert(destination->type == OPERAND_TYPE_REGISTER && "expected register destination");
+        emit_rex(encoder, instruction->size, destination->reg, source->reg);
+        emit_byte(encoder, 0x8b);
+        emit_modrm(encoder, destination->reg, source);
+    }
+}
+
+static void encode_imul(Encoder* encoder, Instruction* instruction)
+{
+    Operand* source = &instruction->source;
+    Operand* destination = &instruction->destination;
+    assert(destination->type == OPERAND_TYPE_REGISTER && "expected register destination");
+    if (source->type == OPERAND_TYPE_IMMEDIATE) {
+        // the three operand form, with the destination as both factor and product
+        assert(fits_int32(source->value) && "immediate out of range");
+        emit_rex(encoder, instruction->size, destination->reg, destination->reg);
+        emit_byte(encoder, fits_int8(source->value) ? 0x6b : 0x69);
+        emit_modrm(encoder, destination->reg, destination);
+        if (fits_int8(source->value))
+            emit_byte(encoder, (uint8_t) source->value);
+        else
+            emit_int32(encoder, (int32_t) source->value);
+    } else {
+        emit_rex(encoder, instruction->size, destination->reg, source->reg);
+        emit_byte(encoder, 0x0f);
+        emit_byte(encoder, 0xaf);
+        emit_modrm(encoder, destination->reg, source);
+    }
+}
+
+static void encode_shift(Encoder* encoder, Instruction* instruction, int digit)
+{
+    Operand* source = &instruction->source;
+    Operand* destination = &instruction->destination;
+    emit_rex(encoder, instruction->size, 0, destination->reg);
+    if (source->type == OPERAND_TYPE_IMMEDIATE && source->value == 1) {
+        // shifting by one has its own opcode without the immediate
+        emit_byte(encoder, 0xd1);
+        emit_modrm(encoder, digit, destination);
+    } else if (source->type == OPERAND_TYPE_IMMEDIATE) {
+        emit_byte(encoder, 0xc1);
+        emit_modrm(encoder, digit, destination);
+        emit_byte(encoder, (uint8_t) source->value);
+    } else {
+        assert(source->type == OPERAND_TYPE_REGISTER && source->reg == REGISTER_RCX && "shift count must be %cl");
+        emit_byte(encoder, 0xd3);
+        emit_modrm(encoder, digit, destination);
+    }
+}
+
+// REX prefix for a byte register rm, spl, bpl, sil and dil need one
+// even though no bit of it is set.
+static void emit_byte_register_rex(Encoder* encoder, int size, int reg, int rm)
+{
+    uint8_t rex = 0x40 | (size == 8) << 3 | (reg >= 8) << 2 | (rm >= 8);
+    if (rex != 0x40 || (rm >= 4 && rm < 8))
+        emit_byte(encoder, rex);
+}
+
+static void encode_setcc(Encoder* encoder, Instruction* instruction, uint8_t condition)
+{
+    assert(instruction->source.type == OPERAND_TYPE_REGISTER && "expected byte register");
+    emit_byte_register_rex(encoder, 4, 0, instruction->source.reg);
+    emit_byte(encoder, 0x0f);
+    emit_byte(encoder, condition);
+    emit_modrm(encoder, 0, &instruction->source);
+}
+
+static void encode_instruction(Encoder* encoder, Instruction* instruction)
+{
+    switch (instruction->opcode) {
+    case OPCODE_LABEL:
+        encoder->label_offsets[instruction->source.value] = string_builder_length(encoder->bytes);
+        break;
+    case OPCODE_MOV:
+        encode_mov(encoder, instruction);
+        break;
+    case OPCODE_ADD:
+        encode_arithmetic(encoder, instruction, 0x01, 0x03, 0);
+        break;
+    case OPCODE_SUB:
+        encode_arithmetic(encoder, instruction, 0x29, 0x2b, 5);
+        break;
+    case OPCODE_IMUL:
+        encode_imul(encoder, instruction);
+        break;
+    case OPCODE_IDIV:
+        emit_rex(encoder, instruction->size, 0, instruction->source.reg);
+        emit_byte(encoder, 0xf7);
+        emit_modrm(encoder, 7, &instruction->source);
+        break;
+    case OPCODE_CLTD:
+        emit_byte(encoder, 0x99);
+        break;
+    case OPCODE_AND:
+        encode_arithmetic(encoder, instruction, 0x21, 0x23, 4);
+        break;
+    case OPCODE_OR:
+        encode_arithmetic(encoder, instruction, 0x09, 0x0b, 1);
+        break;
+    case OPCODE_XOR:
+        encode_arithmetic(encoder, instruction, 0x31, 0x33, 6);
+        break;
+    case OPCODE_CMP:
+        encode_arithmetic(encoder, instruction, 0x39, 0x3b, 7);
+        break;
+    case OPCODE_SHL:
+        encode_shift(encoder, instruction, 4);
+        break;
+    case OPCODE_SAR:
+        encode_shift(encoder, instruction, 7);
+        break;
+    case OPCODE_SETE:
+        encode_setcc(encoder, instruction, 0x94);
+        break;
+    case OPCODE_SETNE:
+        encode_setcc(encoder, instruction, 0x95);
+        break;
+    case OPCODE_SETL:
+        encode_setcc(encoder, instruction, 0x9c);
+        break;
+    case OPCODE_SETLE:
+        encode_setcc(encoder, instruction, 0x9e);
+        break;
+    case OPCODE_SETG:
+        encode_setcc(encoder, instruction, 0x9f);
+        break;
+    case OPCODE_SETGE:
+        encode_setcc(encoder, instruction, 0x9d);
+        break;
+    case OPCODE_MOVZB:
+        assert(instruction->destination.type == OPERAND_TYPE_REGISTER && "expected register destination");
+        emit_byte_register_rex(encoder, instruction->size, instruction->destination.reg, instruction->source.reg);
+        emit_byte(encoder, 0x0f);
+        emit_byte(encoder, 0xb6);
+        emit_modrm(encoder, instruction->destination.reg, &instruction->source);
+        break;
+    case OPCODE_PUSH:
+        emit_rex(encoder, 4, 0, instruction->source.reg);
+        emit_byte(encoder, 0x50 + (instruction->source.reg & 7));
+        break;
+    case OPCODE_POP:
+        emit_rex(encoder, 4, 0, instruction->source.reg);
+        emit_byte(encoder, 0x58 + (instruction->source.reg & 7));
+        break;
+    case OPCODE_CALL:
+        emit_byte(encoder, 0xe8);
+        emit_label_reference(encoder, instruction->source.value, 4);
+        break;
+    case OPCODE_JMP:
+        emit_byte(encoder, encoder->short_jump ? 0xeb : 0xe9);
+        emit_label_reference(encoder, instruction->source.value, encoder->short_jump ? 1 : 4);
+        break;
+    case OPCODE_JNE:
+        if (encoder->short_jump) {
+            emit_byte(encoder, 0x75);
+        } else {
+            emit_byte(encoder, 0x0f);
+            emit_byte(encoder, 0x85);
+        }
+        emit_label_reference(encoder, instruction->source.value, encoder->short_jump ? 1 : 4);
+        break;
+    case OPCODE_RET:
+        emit_byte(encoder, 0xc3);
+        break;
+    case OPCODE_INT:
+        emit_byte(encoder, 0xcd);
+        emit_byte(encoder, (uint8_t) instruction->source.value);
+        break;
+    }
+}
+
+// Encodes every instruction, a jmp or jne with a rel8 where short_jumps says so.
+static void encode_pass(Assembly* self, Encoder* encoder, const bool* short_jumps)
+{
+    size_t labels_length = self->m_label_names->length(self->m_label_names);
+    for (size_t i = 0; i < labels_length; i++)
+        encoder->label_offsets[i] = SIZE_MAX;
+    encoder->fixups_length = 0;
+    for (size_t i = 0; i < self->m_length; i++) {
+        encoder->instruction_offsets[i] = string_builder_length(encoder->bytes);
+        encoder->short_jump = short_jumps && short_jumps[i];
+        encode_instruction(encoder, &self->m_instructions[i]);
+    }
+
+    char* code = string_builder_buffer(encoder->bytes);
+    for (size_t i = 0; i < encoder->fixups_length; i++) {
+        size_t offset = encoder->fixups[i * 3];
+        size_t width = encoder->fixups[i * 3 + 1];
+        size_t target = encoder->label_offsets[encoder->fixups[i * 3 + 2]];
+        assert(target != SIZE_MAX && "reference to label which is never placed");
+        // relative to the end of the rel32 or rel8, which ends the instruction
+        int32_t relative = (int32_t) (target - (offset + width));
+        if (width == 1)
+            code[offset] = (char) (int8_t) relative;
+        else
+            memcpy(code + offset, &relative, sizeof(relative));
+    }
+}
+
+// Jumps are encoded with a rel32 first. Shortening a jump only brings
+// labels closer together, so every jump whose target is in rel8 range
+// then still is once they are all shortened in a second pass.
+size_t* assembly_encode(Assembly* self, StringBuilder* bytes)
+{
+    size_t labels_length = self->m_label_names->length(self->m_label_names);
+    StringBuilder* long_bytes = new_string_builder();
+    Encoder encoder = {
+        .bytes = long_bytes,
+        .label_offsets = counted_malloc(sizeof(size_t) * (labels_length + 1)),
+        .instruction_offsets = counted_malloc(sizeof(size_t) * (self->m_length + 1)),
+        .short_jump = false,
+        .fixups = NULL,
+        .fixups_length = 0,
+        .fixups_capacity = 0,
+    };
+    encode_pass(self, &encoder, NULL);
+
+    bool* short_jumps = counted_calloc(self->m_length + 1, sizeof(bool));
+    for (size_t i = 0; i < self->m_length; i++) {
+        Instruction* instruction = &self->m_instructions[i];
+        if (instruction->opcode != OPCODE_JMP && instruction->opcode != OPCODE_JNE)
+            continue;
+        size_t target = encoder.label_offsets[instruction->source.value];
+        short_jumps[i] = target != SIZE_MAX
+            && fits_int8((int64_t) target - (int64_t) (encoder.instruction_offsets[i] + 2));
+    }
+    encoder.bytes = bytes;
+    encode_pass(self, &encoder, short_jumps);
+
+    free(short_jumps);
+    delete_string_builder(long_bytes);
+    free(encoder.instruction_offsets);
+    free(encoder.fixups);
+    return encoder.label_offsets;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "utils.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum Register {
+    REGISTER_RAX,
+    REGISTER_RCX,
+    REGISTER_RDX,
+    REGISTER_RBX,
+    REGISTER_RSP,
+    REGISTER_RBP,
+    REGISTER_RSI,
+    REGISTER_RDI,
+    REGISTER_R8,
+    REGISTER_R9,
+    REGISTER_R10,
+    REGISTER_R11,
+    REGISTER_R12,
+    REGISTER_R13,
+    REGISTER_R14,
+    REGISTER_R15,
+} Register;
+
+const char* register_to_string(Register reg, int size);
+
+typedef enum OperandType {
+    OPERAND_TYPE_NONE,
+    OPERAND_TYPE_REGISTER,
+    OPERAND_TYPE_IMMEDIATE,
+    // value(%reg)
+    OPERAND_TYPE_MEMORY,
+    // value is a label id
+    OPERAND_TYPE_LABEL,
+} OperandType;
+
+typedef struct Operand {
+    OperandType type;
+    Register reg;
+    int64_t value;
+} Operand;
+
+Operand operand_none();
+Operand operand_register(Register reg);
+Operand operand_immediate(int64_t value);
+Operand operand_memory(Register base, int32_t displacement);
+Operand operand_label(int label);
+
+typedef enum Opcode {
+    // pseudo instruction, source is the label
+    OPCODE_LABEL,
+    OPCODE_MOV,
+    OPCODE_ADD,
+    OPCODE_SUB,
+    OPCODE_IMUL,
+    // divides %edx:%eax by source, quotient in %eax and remainder in %edx
+    OPCODE_IDIV,
+    // sign extends %eax into %edx
+    OPCODE_CLTD,
+    OPCODE_AND,
+    OPCODE_OR,
+    OPCODE_XOR,
+    OPCODE_CMP,
+    // shifts by an immediate or by %cl
+    OPCODE_SHL,
+    OPCODE_SAR,
+    // set the byte register source to 0 or 1 from the flags of a cmp
+    OPCODE_SETE,
+    OPCODE_SETNE,
+    OPCODE_SETL,
+    OPCODE_SETLE,
+    OPCODE_SETG,
+    OPCODE_SETGE,
+    // zero extends the byte register source
+    OPCODE_MOVZB,
+    OPCODE_PUSH,
+    OPCODE_POP,
+    OPCODE_CALL,
+    OPCODE_JMP,
+    // jumps when the last cmp found its operands not equal
+    OPCODE_JNE,
+    OPCODE_RET,
+    OPCODE_INT,
+} Opcode;
+
+const char* opcode_to_string(Opcode opcode);
+
+// Operands are in AT&T order, source before destination.
+typedef struct Instruction {
+    Opcode opcode;
+    // operand size in bytes, 1, 4 or 8
+    int size;
+    Operand source;
+    Operand destination;
+} Instruction;
+
+typedef struct Assembly {
+    size_t m_length;
+    size_t m_capacity;
+    Instruction* m_instructions;
+    List* m_label_names;
+    StringHashMap* m_label_ids;
+} Assembly;
+
+Assembly* new_assembly();
+void delete_assembly(Assembly* self);
+size_t assembly_length(Assembly* self);
+Instruction* assembly_get(Assembly* self, size_t index);
+void assembly_add(Assembly* self, Opcode opcode, int size, Operand source, Operand destination);
+// Drops every instruction from length on.
+void assembly_truncate(Assembly* self, size_t length);
+// Appends the instructions of other, labels with the same name are the
+// same label.
+void assembly_append(Assembly* self, Assembly* other);
+// Returns the id of the label with the given name, creating it if needed.
+int assembly_label(Assembly* self, const char* name);
+const char* assembly_label_name(Assembly* self, int label);
+size_t assembly_labels_length(Assembly* self);
+void assembly_place_label(Assembly* self, int label);
+char* assembly_to_string(Assembly* self);
+// Appends the instructions and label names in a binary form read back by
+// new_assembly_from_bytes.
+void assembly_write(Assembly* self, StringBuilder* bytes);
+// Returns NULL when bytes aren't something assembly_write wrote.
+Assembly* new_assembly_from_bytes(const char* bytes, size_t length);
+// Encodes the instructions as x86-64 machine code into bytes, and returns
+// the offset of every label in a newly allocated array.
+size_t* assembly_encode(Assembly* self, StringBuilder* bytes);
+
+// Rewrites the instructions of one function: drops unreachable code, jumps
+// to the next instruction and the frame of leaf functions that don't
+// spill, folds moves through %rax, and picks shorter forms of some
+// instructions.
+void peephole(Assembly* self);
+
+void elf_write_executable(StringBuilder* bytes, const char* code, size_t code_length, size_t entry_offset);
+// Appends the static executable starting at _start.
+void assembly_write_executable(Assembly* self, StringBuilder* bytes);
+void write_executable_file(const char* path, const char* bytes, size_t length);
+
+// neocc functions take no arguments, and only use caller saved registers,
+// so C can call them directly.
+typedef int (*JitFunction)(void);
+
+// The machine code of an Assembly in memory mapped executable, in the
+// process that compiled it.
+typedef struct JitCode {
+    char* m_memory;
+    size_t m_length;
+    size_t m_labels_length;
+    size_t* m_label_offsets;
+} JitCode;
+
+JitCode* new_jit_code(Assembly* assembly);
+void delete_jit_code(JitCode* self);
+size_t jit_code_length(JitCode* self);
+// The address of a label of the Assembly the code was made from.
+void* jit_code_address(JitCode* self, int label);
+// Encodes the instructions, calls main and returns what it returned.
+int jit_run(Assembly* assembly);
+
+// bump when the generated code changes, so older cache entries are missed
+#define FUNCTION_CACHE_VERSION 3
+
+// Assembly of single functions in a directory on disk, one file per key.
+typedef struct FunctionCache {
+    char* directory;
+    atomic_size_t hits;
+    atomic_size_t misses;
+} FunctionCache;
+
+FunctionCache* new_function_cache(const char* directory);
+void delete_function_cache(FunctionCache* self);
+// Returns NULL when there is no entry for key.
+Assembly* function_cache_load(FunctionCache* self, uint64_t key);
+void function_cache_store(FunctionCache* self, uint64_t key, Assembly* assembly);
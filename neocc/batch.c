@@ -0,0 +1,62 @@
+#include "ir.h"
+#include "parser.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct LowerFilesJob {
+    const char** paths;
+    List** functions;
+    // threads for the functions of one file, 1 unless there is only one file
+    int file_jobs;
+    FunctionCache* cache;
+    AstCache* ast_cache;
+} LowerFilesJob;
+
+static void lower_file_job(void* context, size_t index)
+{
+    LowerFilesJob* job = context;
+    MappedFile* source = new_mapped_file(job->paths[index]);
+    Ast* ast = parse_file_cached(source, job->ast_cache);
+    List* functions = lower_cached(ast, job->file_jobs, job->cache);
+    optimize(functions, job->file_jobs);
+    // the IR copies what it needs, the AST and the text can go
+    delete_ast(ast);
+    delete_mapped_file(source);
+    job->functions[index] = functions;
+}
+
+List* lower_files(const char** paths, size_t paths_length, int jobs, FunctionCache* cache, AstCache* ast_cache)
+{
+    LowerFilesJob job = {
+        .paths = paths,
+        .functions = counted_calloc(paths_length, sizeof(List*)),
+        .file_jobs = paths_length == 1 ? jobs : 1,
+        .cache = cache,
+        .ast_cache = ast_cache,
+    };
+    parallel_for(paths_length, jobs, lower_file_job, &job);
+
+    // every function name is global, the table maps it to the defining file
+    StringHashMap* symbols = new_string_hash_map();
+    List* result = (List*) new_array_list();
+    for (size_t i = 0; i < paths_length; i++) {
+        List* functions = job.functions[i];
+        for (int j = 0; j < functions->length(functions); j++) {
+            IrFunction* function = functions->get(functions, j);
+            if (string_hash_map_contains_key(symbols, function->name)) {
+                fprintf(stderr, "error: function %s defined in %s and again in %s\n", function->name,
+                    (const char*) string_hash_map_get(symbols, function->name), paths[i]);
+                abort();
+            }
+            string_hash_map_set(symbols, function->name, (void*) paths[i]);
+            result->add(result, function);
+        }
+        functions->delete(functions);
+    }
+    assert(string_hash_map_contains_key(symbols, "main") && "no function main in any input file");
+    delete_string_hash_map(symbols);
+    free(job.functions);
+    return result;
+}
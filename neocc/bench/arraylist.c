@@ -0,0 +1,36 @@
+#include "utils.h"
+#include "bench.h"
+#include <stdbool.h>
+
+static double bench_exact_realloc(size_t amount)
+{
+    // how array_list_add used to grow: one realloc per element
+    double start = bench_now();
+    void** elements = NULL;
+    for (size_t i = 0; i < amount; i++) {
+        elements = realloc(elements, sizeof(void*) * (i + 1));
+        elements[i] = (void*) i;
+    }
+    free(elements);
+    return bench_now() - start;
+}
+
+static double bench_heap_list(size_t amount, bool reserve)
+{
+    double start = bench_now();
+    ArrayList* list = new_array_list();
+    if (reserve)
+        array_list_reserve(list, amount);
+    for (size_t i = 0; i < amount; i++)
+        array_list_add(list, (void*) i);
+    delete_array_list(list);
+    return bench_now() - start;
+}
+
+int main(int argc, char** argv)
+{
+    size_t amount = bench_arg(argc, argv, 1, 10000000);
+    bench_report("exact realloc per append", bench_exact_realloc(amount), amount, "appends");
+    bench_report("array_list_add", bench_heap_list(amount, false), amount, "appends");
+    bench_report("array_list_add after reserve", bench_heap_list(amount, true), amount, "appends");
+}
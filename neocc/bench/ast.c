@@ -0,0 +1,30 @@
+#include "ir.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+
+int main(int argc, char** argv)
+{
+    size_t functions = bench_arg(argc, argv, 1, 20000);
+    size_t statements = bench_arg(argc, argv, 2, 50);
+
+    char* text = bench_generate_program(functions, statements);
+    size_t length = strlen(text);
+
+    double start = bench_now();
+    Ast* ast = parse(text, length);
+    double parsed = bench_now();
+    List* functions_ir = lower(ast, 1);
+    double lowered = bench_now();
+
+    // node 0 only stands for AST_NONE
+    size_t nodes = ast_length(ast) - 1;
+    printf("%zu bytes of source, %zu nodes of %zu bytes, %.1f bytes/node with the unused capacity\n", length, nodes,
+        sizeof(AstNode), (double) (ast->m_capacity * sizeof(AstNode)) / nodes);
+    bench_report("parse", parsed - start, nodes, "nodes");
+    bench_report("lower", lowered - parsed, nodes, "nodes");
+
+    list_delete_all_and_self(functions_ir, (void (*)(void*)) delete_ir_function);
+    delete_ast(ast);
+    free(text);
+}
@@ -0,0 +1,97 @@
+#define _DEFAULT_SOURCE
+#include "ir.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct FrontEndTimes {
+    double parse;
+    double lower;
+    size_t nodes;
+} FrontEndTimes;
+
+// map, parse or load, lower and optimize, what a run does before compiling
+static FrontEndTimes front_end(const char* path, AstCache* cache, Ast* expected)
+{
+    double start = bench_now();
+    MappedFile* source = new_mapped_file(path);
+    Ast* ast = parse_file_cached(source, cache);
+    double parsed = bench_now();
+    List* functions = lower(ast, 1);
+    optimize(functions, 1);
+    double lowered = bench_now();
+
+    if (expected) {
+        assert(ast_length(ast) == ast_length(expected) && ast->statements == expected->statements);
+        for (size_t i = 1; i < ast_length(ast); i++) {
+            AstNode* node = &ast->nodes[i];
+            AstNode* other = &expected->nodes[i];
+            assert(node->kind == other->kind && node->token_type == other->token_type
+                && node->operation_type == other->operation_type && node->offset == other->offset
+                && node->length == other->length && node->next == other->next && node->first == other->first
+                && node->second == other->second);
+        }
+    }
+    FrontEndTimes times = { .parse = parsed - start, .lower = lowered - parsed, .nodes = ast_length(ast) };
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    delete_ast(ast);
+    delete_mapped_file(source);
+    return times;
+}
+
+static void report(const char* name, FrontEndTimes times)
+{
+    char label[128];
+    snprintf(label, sizeof(label), "%s, parse", name);
+    bench_report(label, times.parse, times.nodes, "nodes");
+    snprintf(label, sizeof(label), "%s, front end", name);
+    bench_report(label, times.parse + times.lower, times.nodes, "nodes");
+}
+
+int main(int argc, char** argv)
+{
+    size_t functions = bench_arg(argc, argv, 1, 5000);
+    size_t statements = bench_arg(argc, argv, 2, 50);
+    size_t runs = bench_arg(argc, argv, 3, 5);
+
+    char directory[] = "/tmp/neocc-ast-cache-XXXXXX";
+    char* created = mkdtemp(directory);
+    assert(created && "could not create temporary directory");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/input.c", directory);
+    char* text = bench_generate_program(functions, statements);
+    write_file(path, text);
+    char cache_directory[4096 + 8];
+    snprintf(cache_directory, sizeof(cache_directory), "%s/cache", directory);
+    AstCache* cache = new_ast_cache(cache_directory);
+
+    Ast* expected = parse(text, strlen(text));
+    // the cold run parses and writes the entry, the others are the best of runs
+    FrontEndTimes cold = front_end(path, cache, expected);
+    FrontEndTimes uncached = front_end(path, NULL, NULL);
+    FrontEndTimes warm = front_end(path, cache, expected);
+    for (size_t i = 1; i < runs; i++) {
+        FrontEndTimes times = front_end(path, NULL, NULL);
+        if (times.parse + times.lower < uncached.parse + uncached.lower)
+            uncached = times;
+        times = front_end(path, cache, expected);
+        if (times.parse + times.lower < warm.parse + warm.lower)
+            warm = times;
+    }
+    assert(cache->misses == 1 && cache->hits == runs);
+
+    report("no cache", uncached);
+    report("cold cache", cold);
+    report("warm cache", warm);
+    printf("%zu bytes of source, %zu bytes of entry, parse %.1fx faster warm\n", strlen(text),
+        sizeof(AstNode) * ast_length(expected) + 32, uncached.parse / warm.parse);
+
+    delete_ast(expected);
+    delete_ast_cache(cache);
+    bench_remove_directory(cache_directory);
+    bench_remove_directory(directory);
+    free(text);
+}
@@ -0,0 +1,70 @@
+#define _DEFAULT_SOURCE
+#include "compiler.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Writes `files` files of `functions` functions each, with names unique
+// across the corpus and main in the first one.
+static char** generate_corpus(const char* directory, size_t files, size_t functions)
+{
+    char** paths = calloc(files, sizeof(char*));
+    for (size_t i = 0; i < files; i++) {
+        BenchText text = { 0 };
+        for (size_t f = 0; f < functions; f++) {
+            bench_text_write(&text, "int file_%zu_function_%zu()\n{\n", i, f);
+            bench_text_write(&text, "    int value_0 = %zu;\n", f);
+            for (size_t s = 1; s < 10; s++)
+                bench_text_write(&text, "    int value_%zu = %zu * value_%zu + 3;\n", s, s, s - 1);
+            bench_text_write(&text, "    return value_9 %% 256;\n}\n\n");
+        }
+        if (i == 0)
+            bench_text_write(&text, "int main()\n{\n    return 0;\n}\n");
+        paths[i] = malloc(4096);
+        snprintf(paths[i], 4096, "%s/file_%zu.c", directory, i);
+        write_file(paths[i], text.buffer);
+        free(text.buffer);
+    }
+    return paths;
+}
+
+int main(int argc, char** argv)
+{
+    size_t files = bench_arg(argc, argv, 1, 1000);
+    size_t functions = bench_arg(argc, argv, 2, 20);
+    int max_jobs = (int) bench_arg(argc, argv, 3, sysconf(_SC_NPROCESSORS_ONLN));
+
+    char directory[] = "/tmp/neocc-batch-XXXXXX";
+    char* created = mkdtemp(directory);
+    assert(created && "could not create temporary directory");
+    char** paths = generate_corpus(directory, files, functions);
+
+    double single = 0;
+    // 1, 2, 4, ... jobs, ending at max_jobs
+    for (int jobs = 1;; jobs = jobs * 2 < max_jobs ? jobs * 2 : max_jobs) {
+        double start = bench_now();
+        List* result = lower_files((const char**) paths, files, jobs, NULL, NULL);
+        Assembly* assembly = compile_to_assembly(result, jobs);
+        double elapsed = bench_now() - start;
+        assert((size_t) result->length(result) == files * functions + 1);
+        delete_assembly(assembly);
+        list_delete_all_and_self(result, (void (*)(void*)) delete_ir_function);
+
+        if (jobs == 1)
+            single = elapsed;
+        char name[64];
+        snprintf(name, sizeof(name), "%d jobs, %.2fx of 1 job", jobs, single / elapsed);
+        bench_report(name, elapsed, files, "files");
+        if (jobs == max_jobs)
+            break;
+    }
+
+    for (size_t i = 0; i < files; i++) {
+        unlink(paths[i]);
+        free(paths[i]);
+    }
+    free(paths);
+    rmdir(directory);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static inline double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static inline size_t bench_arg(int argc, char** argv, int index, size_t fallback)
+{
+    return argc > index ? (size_t) strtoull(argv[index], NULL, 10) : fallback;
+}
+
+static inline void bench_report(const char* name, double seconds, size_t amount, const char* unit)
+{
+    printf("%-40s %10.3f ms %14.0f %s/s\n", name, seconds * 1e3, (double) amount / seconds, unit);
+}
+
+// Removes a temporary directory and the files in it, benchmarks create no
+// subdirectories.
+static inline void bench_remove_directory(const char* path)
+{
+    DIR* directory = opendir(path);
+    if (!directory)
+        return;
+    struct dirent* entry;
+    char entry_path[4096];
+    while ((entry = readdir(directory))) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name);
+        unlink(entry_path);
+    }
+    closedir(directory);
+    rmdir(path);
+}
+
+typedef struct BenchText {
+    size_t length;
+    size_t capacity;
+    char* buffer;
+} BenchText;
+
+static inline void bench_text_write(BenchText* self, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    char line[256];
+    int length = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (self->length + length + 1 > self->capacity) {
+        self->capacity = (self->length + length + 1) * 2;
+        self->buffer = realloc(self->buffer, self->capacity);
+    }
+    memcpy(self->buffer + self->length, line, length + 1);
+    self->length += length;
+}
+
+// Generates `functions` functions with `statements` declarations each,
+// using only the syntax neocc currently parses.
+static inline char* bench_generate_program(size_t functions, size_t statements)
+{
+    BenchText text = { 0 };
+    for (size_t f = 0; f < functions; f++) {
+        bench_text_write(&text, "int function_%zu()\n{\n", f);
+        bench_text_write(&text, "    int value_0 = %zu;\n", f);
+        for (size_t s = 1; s < statements; s++)
+            bench_text_write(&text, "    int value_%zu = %zu + value_%zu + 3;\n", s, s, s - 1);
+        bench_text_write(&text, "    return %zu;\n}\n\n", f % 256);
+    }
+    bench_text_write(&text, "int main()\n{\n    return 0;\n}\n");
+    return text.buffer;
+}
+
+// Generates `functions` functions that each declare one value from a single
+// addition chain `depth` terms long, so parsing and lowering recurse deeply.
+static inline char* bench_generate_deep_program(size_t functions, size_t depth)
+{
+    BenchText text = { 0 };
+    for (size_t f = 0; f < functions; f++) {
+        bench_text_write(&text, "int function_%zu()\n{\n    int value = %zu", f, f);
+        for (size_t d = 1; d < depth; d++)
+            bench_text_write(&text, d % 16 == 0 ? "\n        + %zu" : " + %zu", d % 10);
+        bench_text_write(&text, ";\n    return %zu;\n}\n\n", f % 256);
+    }
+    bench_text_write(&text, "int main()\n{\n    return 0;\n}\n");
+    return text.buffer;
+}
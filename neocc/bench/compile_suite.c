@@ -0,0 +1,125 @@
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+// Times every phase of the compiler over generated programs and compares
+// the throughput against the stored baselines. --write-baseline replaces
+// the baselines with this run, --check fails when any phase got slower
+// than the tolerance allows.
+
+#define BASELINE_PATH "bench/compile_suite.baseline"
+#define BASELINE_TOLERANCE 0.75
+#define MAX_RESULTS 64
+
+typedef struct Result {
+    char name[64];
+    double lines_per_second;
+    double tokens_per_second;
+} Result;
+
+typedef struct Suite {
+    Result results[MAX_RESULTS];
+    size_t results_length;
+} Suite;
+
+static void suite_add(Suite* suite, const char* program, const char* phase, double seconds, size_t lines, size_t tokens)
+{
+    assert(suite->results_length < MAX_RESULTS);
+    Result* result = &suite->results[suite->results_length++];
+    snprintf(result->name, sizeof(result->name), "%s/%s", program, phase);
+    result->lines_per_second = (double) lines / seconds;
+    result->tokens_per_second = (double) tokens / seconds;
+    printf("%-32s %10.3f ms %12.0f lines/s %12.0f tokens/s\n", result->name, seconds * 1e3, result->lines_per_second,
+        result->tokens_per_second);
+}
+
+static void run_program(Suite* suite, const char* program, char* text)
+{
+    size_t length = strlen(text);
+    size_t lines = 0;
+    for (size_t i = 0; i < length; i++)
+        lines += text[i] == '\n';
+
+    double start = bench_now();
+    TokenBuffer* tokens = tokenize(text, length);
+    double tokenized = bench_now();
+    size_t token_amount = token_buffer_length(tokens);
+    delete_token_buffer(tokens);
+
+    double parse_start = bench_now();
+    Ast* ast = parse(text, length);
+    double parsed = bench_now();
+    List* functions = lower(ast, 1);
+    double lowered = bench_now();
+    optimize(functions, 1);
+    double optimized = bench_now();
+    char* assembly = compile(functions, 1);
+    double compiled = bench_now();
+
+    suite_add(suite, program, "tokenize", tokenized - start, lines, token_amount);
+    suite_add(suite, program, "parse", parsed - parse_start, lines, token_amount);
+    suite_add(suite, program, "lower", lowered - parsed, lines, token_amount);
+    suite_add(suite, program, "optimize", optimized - lowered, lines, token_amount);
+    suite_add(suite, program, "compile", compiled - optimized, lines, token_amount);
+
+    free(assembly);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    delete_ast(ast);
+    free(text);
+}
+
+static void write_baseline(Suite* suite)
+{
+    FILE* fp = fopen(BASELINE_PATH, "w");
+    assert(fp && "could not write baseline");
+    for (size_t i = 0; i < suite->results_length; i++)
+        fprintf(fp, "%s %.0f\n", suite->results[i].name, suite->results[i].lines_per_second);
+    fclose(fp);
+    printf("wrote %zu baselines to %s\n", suite->results_length, BASELINE_PATH);
+}
+
+// Returns the amount of phases slower than the tolerance allows.
+static int compare_baseline(Suite* suite)
+{
+    FILE* fp = fopen(BASELINE_PATH, "r");
+    if (!fp) {
+        printf("no baselines in %s, run with --write-baseline\n", BASELINE_PATH);
+        return 0;
+    }
+    int regressions = 0;
+    char name[64];
+    double baseline;
+    while (fscanf(fp, "%63s %lf", name, &baseline) == 2) {
+        for (size_t i = 0; i < suite->results_length; i++) {
+            if (strcmp(suite->results[i].name, name) != 0)
+                continue;
+            double ratio = suite->results[i].lines_per_second / baseline;
+            bool regressed = ratio < BASELINE_TOLERANCE;
+            printf("%-32s %6.2fx baseline%s\n", name, ratio, regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+        }
+    }
+    fclose(fp);
+    return regressions;
+}
+
+int main(int argc, char** argv)
+{
+    bool write = argc > 1 && strcmp(argv[1], "--write-baseline") == 0;
+    bool check = argc > 1 && strcmp(argv[1], "--check") == 0;
+
+    Suite suite = { 0 };
+    run_program(&suite, "small", bench_generate_program(2000, 10));
+    run_program(&suite, "wide", bench_generate_program(20000, 20));
+    run_program(&suite, "long", bench_generate_program(200, 2000));
+    run_program(&suite, "deep", bench_generate_deep_program(200, 2000));
+
+    if (write) {
+        write_baseline(&suite);
+        return 0;
+    }
+    int regressions = compare_baseline(&suite);
+    return check && regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,53 @@
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+
+// One expression of `terms` terms mixing every binary operator. tests/expression
+// checks the tree of the same expression.
+static char* generate_expression_program(size_t terms)
+{
+    static const char* operators[] = {
+        "+", "-", "*", "+", "^", "|", "&", "+", "<<", ">>", "==", "!=", "<", ">=", "&&", "||", "/", "%",
+    };
+    size_t operators_length = sizeof(operators) / sizeof(operators[0]);
+    BenchText text = { 0 };
+    bench_text_write(&text, "int main()\n{\n    int a = 3;\n    int value = a");
+    for (size_t i = 1; i < terms; i++) {
+        const char* operator = operators[i % operators_length];
+        // divisors and shift counts stay small and non-zero
+        bool small = operator[0] == '/' || operator[0] == '%' || operator[1] == '<' || operator[1] == '>';
+        bench_text_write(&text, i % 8 == 0 ? "\n        %s %zu" : " %s %zu", operator, small ? 1 + i % 3 : i % 100);
+    }
+    bench_text_write(&text, ";\n    return value & 255;\n}\n");
+    return text.buffer;
+}
+
+int main(int argc, char** argv)
+{
+    size_t terms = bench_arg(argc, argv, 1, 1000000);
+
+    char* text = generate_expression_program(terms);
+    double start = bench_now();
+    Ast* ast = parse(text, strlen(text));
+    double parsed = bench_now();
+
+
+    List* functions = lower(ast, 1);
+    double lowered = bench_now();
+    optimize(functions, 1);
+    double optimized = bench_now();
+    char* assembly = compile(functions, 1);
+    double compiled = bench_now();
+
+    printf("%zu terms\n", terms);
+    bench_report("parse", parsed - start, terms, "terms");
+    bench_report("lower", lowered - parsed, terms, "terms");
+    bench_report("optimize", optimized - lowered, terms, "terms");
+    bench_report("compile", compiled - optimized, terms, "terms");
+
+    free(assembly);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    delete_ast(ast);
+    free(text);
+}
@@ -0,0 +1,60 @@
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+int main(int argc, char** argv)
+{
+    size_t amount = bench_arg(argc, argv, 1, 1000000);
+
+    char** keys = calloc(amount, sizeof(char*));
+    for (size_t i = 0; i < amount; i++) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "symbol_%zu", i);
+        keys[i] = copy_string(buffer);
+    }
+
+    StringHashMap* map = new_string_hash_map();
+
+    double start = bench_now();
+    for (size_t i = 0; i < amount; i++)
+        string_hash_map_set(map, keys[i], (void*) i);
+    bench_report("string_hash_map_set", bench_now() - start, amount, "ops");
+
+    start = bench_now();
+    size_t sum = 0;
+    for (size_t i = 0; i < amount; i++)
+        sum += (size_t) string_hash_map_get(map, keys[i]);
+    bench_report("string_hash_map_get (hit)", bench_now() - start, amount, "ops");
+
+    start = bench_now();
+    size_t misses = 0;
+    for (size_t i = 0; i < amount; i++) {
+        // "symbol" followed by the key's own digits never collides with a key
+        const char* digits = keys[i] + strlen("symbol_");
+        char missing[32] = "symbol";
+        strcat(missing, digits);
+        misses += !string_hash_map_find(map, missing, strlen(missing));
+    }
+    bench_report("string_hash_map_find (miss)", bench_now() - start, amount, "ops");
+
+    start = bench_now();
+    for (size_t i = 0; i < amount; i += 2)
+        string_hash_map_remove(map, keys[i]);
+    bench_report("string_hash_map_remove", bench_now() - start, amount / 2, "ops");
+
+    start = bench_now();
+    size_t cursor = 0, iterated = 0;
+    while (string_hash_map_iterate(map, &cursor))
+        iterated++;
+    bench_report("string_hash_map_iterate", bench_now() - start, iterated, "elements");
+
+    assert(sum == amount * (amount - 1) / 2);
+    assert(misses == amount);
+    assert(iterated == string_hash_map_length(map));
+    printf("checksum %zu, misses %zu\n", sum, misses);
+
+    delete_string_hash_map(map);
+    for (size_t i = 0; i < amount; i++)
+        free(keys[i]);
+    free(keys);
+}
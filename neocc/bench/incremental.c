@@ -0,0 +1,61 @@
+#define _DEFAULT_SOURCE
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// parse, lower, optimize and compile, the part of a run the cache changes
+static double build(char* text, FunctionCache* cache)
+{
+    double start = bench_now();
+    Ast* ast = parse(text, strlen(text));
+    List* functions = lower_cached(ast, 1, cache);
+    optimize(functions, 1);
+    char* assembly = compile(functions, 1);
+    double elapsed = bench_now() - start;
+    free(assembly);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    delete_ast(ast);
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    size_t functions = bench_arg(argc, argv, 1, 5000);
+    size_t statements = bench_arg(argc, argv, 2, 50);
+
+    char* text = bench_generate_program(functions, statements);
+    char directory[] = "/tmp/neocc-cache-XXXXXX";
+    char* created = mkdtemp(directory);
+    assert(created && "could not create temporary directory");
+
+    double uncached = build(text, NULL);
+    FunctionCache* cache = new_function_cache(directory);
+    double cold = build(text, cache);
+    double warm = build(text, cache);
+    size_t warm_hits = cache->hits;
+
+    // edits one digit in the first statement of the middle function
+    char name[64];
+    snprintf(name, sizeof(name), "int function_%zu()", functions / 2);
+    char* edit = strstr(strstr(text, name), "value_0 = ") + strlen("value_0 = ");
+    *edit = *edit == '1' ? '2' : '1';
+    cache->hits = 0;
+    cache->misses = 0;
+    double edited = build(text, cache);
+    printf("%zu functions, after editing one: %zu cached, %zu compiled\n", functions + 1, (size_t) cache->hits,
+        (size_t) cache->misses);
+    assert(warm_hits == functions + 1 && cache->misses == 1);
+
+    bench_report("build without cache", uncached, functions, "functions");
+    bench_report("build, cold cache", cold, functions, "functions");
+    bench_report("rebuild, nothing changed", warm, functions, "functions");
+    bench_report("rebuild, one function edited", edited, functions, "functions");
+
+    delete_function_cache(cache);
+    bench_remove_directory(directory);
+    free(text);
+}
@@ -0,0 +1,112 @@
+#define _DEFAULT_SOURCE
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Small programs like the ones in examples/, and what main returns.
+static const char* programs[] = {
+    "int main()\n{\n    int a = 3;\n    int b = 5;\n    return a + b;\n}\n",
+    "int main()\n{\n    int x = 3;\n    int y = x + x + 1;\n    return y + x;\n}\n",
+    "int main()\n{\n    int a = 7;\n    int b = (a - 2) * 3 % 4 << 2;\n    return b + (a > 3 && b != 0) - 10 / 3;\n}\n",
+};
+static const int results[] = { 8, 10, 10 };
+#define PROGRAMS_LENGTH (sizeof(programs) / sizeof(programs[0]))
+
+static List* front_end(const char* text)
+{
+    Ast* ast = parse(text, strlen(text));
+    List* functions = lower(ast, 1);
+    optimize(functions, 1);
+    delete_ast(ast);
+    return functions;
+}
+
+static int run_in_process(const char* text)
+{
+    List* functions = front_end(text);
+    Assembly* assembly = compile_to_assembly(functions, 1);
+    int result = jit_run(assembly);
+    delete_assembly(assembly);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    return result;
+}
+
+static int run_executable(const char* text, const char* path)
+{
+    List* functions = front_end(text);
+    compile_to_executable(functions, 1, path);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    pid_t child = fork();
+    if (child == 0) {
+        execl(path, path, (char*) NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    return WEXITSTATUS(status);
+}
+
+int main(int argc, char** argv)
+{
+    size_t runs = bench_arg(argc, argv, 1, 2000);
+
+    double start = bench_now();
+    for (size_t i = 0; i < runs; i++) {
+        int result = run_in_process(programs[i % PROGRAMS_LENGTH]);
+        assert(result == results[i % PROGRAMS_LENGTH]);
+    }
+    double seconds = bench_now() - start;
+    bench_report("compile and call main in process", seconds, runs, "tests");
+    printf("    %.1f us per test\n", seconds / runs * 1e6);
+
+    char directory[] = "/tmp/neocc-bench-XXXXXX";
+    char* created = mkdtemp(directory);
+    assert(created && "could not create temporary directory");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/a.out", directory);
+    size_t executables = runs / 10 > 0 ? runs / 10 : 1;
+    start = bench_now();
+    for (size_t i = 0; i < executables; i++) {
+        int result = run_executable(programs[i % PROGRAMS_LENGTH], path);
+        assert(result == results[i % PROGRAMS_LENGTH]);
+    }
+    seconds = bench_now() - start;
+    bench_report("compile, write and exec an executable", seconds, executables, "tests");
+    printf("    %.1f us per test\n", seconds / executables * 1e6);
+
+    // what a test harness pays today, one neocc process with as and ld and
+    // then the program, when neocc is built
+    char neocc[4096];
+    if (realpath("neocc", neocc)) {
+        char source[4096];
+        snprintf(source, sizeof(source), "%s/input.c", directory);
+        char command[16384];
+        size_t processes = runs / 100 > 0 ? runs / 100 : 1;
+        start = bench_now();
+        for (size_t i = 0; i < processes; i++) {
+            write_file(source, (char*) programs[i % PROGRAMS_LENGTH]);
+            snprintf(command, sizeof(command), "cd %s && %s input.c && ./a.out", directory, neocc);
+            int status = system(command);
+            assert(WEXITSTATUS(status) == results[i % PROGRAMS_LENGTH]);
+        }
+        seconds = bench_now() - start;
+        bench_report("neocc with as and ld, then a.out", seconds, processes, "tests");
+        printf("    %.1f us per test\n", seconds / processes * 1e6);
+        start = bench_now();
+        for (size_t i = 0; i < processes; i++) {
+            write_file(source, (char*) programs[i % PROGRAMS_LENGTH]);
+            snprintf(command, sizeof(command), "%s --run %s", neocc, source);
+            int status = system(command);
+            assert(WEXITSTATUS(status) == results[i % PROGRAMS_LENGTH]);
+        }
+        seconds = bench_now() - start;
+        bench_report("neocc --run", seconds, processes, "tests");
+        printf("    %.1f us per test\n", seconds / processes * 1e6);
+    }
+    bench_remove_directory(directory);
+}
@@ -0,0 +1,62 @@
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+// Identifiers sharing prefixes with keywords, and the keywords themselves,
+// in indented lines.
+static const char* words[] = {
+    "integer", "int", "intx", "returnValue", "return", "if_", "if", "for4", "for",
+    "voidness", "void", "while", "whiled", "break", "breakpoint", "cases", "case",
+    "switch", "switcher", "continue", "continued", "else", "elsewhere", "value",
+};
+#define WORDS_LENGTH (sizeof(words) / sizeof(words[0]))
+#define KEYWORDS_PER_ROUND 11
+
+int main(int argc, char** argv)
+{
+    size_t megabytes = bench_arg(argc, argv, 1, 32);
+
+    BenchText text = { 0 };
+    size_t rounds = 0;
+    while (text.length < megabytes << 20) {
+        for (size_t i = 0; i < WORDS_LENGTH; i++)
+            bench_text_write(&text, "%s%s", words[i], i % 8 == 7 ? "\n                " : " ");
+        rounds++;
+    }
+
+    Lexer* lexer = new_lexer(text.buffer, text.length);
+    double start = bench_now();
+    TokenBuffer* tokens = lexer_tokenize(lexer);
+    double seconds = bench_now() - start;
+    delete_lexer(lexer);
+
+    size_t keywords = 0, identifiers = 0;
+    for (size_t i = 0; i < token_buffer_length(tokens); i++) {
+        identifiers += tokens->types[i] == TOKEN_TYPE_IDENTIFIER;
+        keywords += tokens->types[i] != TOKEN_TYPE_IDENTIFIER && tokens->types[i] != TOKEN_TYPE_EOF;
+    }
+    assert(keywords == rounds * KEYWORDS_PER_ROUND && "keyword misclassified");
+    assert(identifiers == rounds * (WORDS_LENGTH - KEYWORDS_PER_ROUND) && "identifier misclassified");
+
+    Lexer* scalar_lexer = new_lexer(text.buffer, text.length);
+    scalar_lexer->scalar = true;
+    double scalar_start = bench_now();
+    TokenBuffer* scalar_tokens = lexer_tokenize(scalar_lexer);
+    double scalar_seconds = bench_now() - scalar_start;
+    delete_lexer(scalar_lexer);
+
+    assert(token_buffer_length(scalar_tokens) == token_buffer_length(tokens));
+    for (size_t i = 0; i < token_buffer_length(tokens); i++)
+        assert(tokens->types[i] == scalar_tokens->types[i] && tokens->offsets[i] == scalar_tokens->offsets[i]
+            && tokens->lengths[i] == scalar_tokens->lengths[i] && "scalar and 16 byte runs disagree");
+
+    printf("%zu MB identifier heavy input, %zu tokens\n", text.length >> 20, keywords + identifiers);
+    bench_report("tokenize", seconds, text.length >> 20, "MB");
+    bench_report("tokenize", seconds, keywords + identifiers, "tokens");
+    bench_report("tokenize, scalar runs", scalar_seconds, text.length >> 20, "MB");
+
+    delete_token_buffer(scalar_tokens);
+    delete_token_buffer(tokens);
+    free(text.buffer);
+}
@@ -0,0 +1,95 @@
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+// The same line starts found by calling memchr once per line instead of
+// comparing 16 bytes at a time.
+static size_t memchr_line_starts(const char* text, size_t length, uint32_t* starts)
+{
+    size_t lines = 0;
+    starts[lines++] = 0;
+    for (const char* found = text; (found = memchr(found, '\n', text + length - found)); found++)
+        starts[lines++] = found - text + 1;
+    return lines;
+}
+
+// What finding a position costs without an index.
+static SourcePosition rescan_position(const char* text, size_t offset)
+{
+    SourcePosition position = { .line = 1, .column = 1 };
+    for (size_t i = 0; i < offset; i++) {
+        if (text[i] == '\n') {
+            position.line++;
+            position.column = 1;
+        } else {
+            position.column++;
+        }
+    }
+    return position;
+}
+
+int main(int argc, char** argv)
+{
+    size_t lines = bench_arg(argc, argv, 1, 5000000);
+    size_t lookups = bench_arg(argc, argv, 2, 1000000);
+
+    // lines of varying length like source code, some of them empty
+    BenchText text = { 0 };
+    for (size_t i = 0; i < lines; i++) {
+        if (i % 7 == 0)
+            bench_text_write(&text, "\n");
+        else
+            bench_text_write(&text, "%*sint value_%zu = value_%zu + %zu;\n", (int) (i % 3) * 4, "", i, i / 2, i % 100);
+    }
+
+    double start = bench_now();
+    LineIndex* index = new_line_index(text.buffer, text.length);
+    double seconds = bench_now() - start;
+    // the last line is empty, after the final newline
+    assert(line_index_lines_length(index) == lines + 1);
+    bench_report("new_line_index", seconds, text.length, "bytes");
+    bench_report("new_line_index", seconds, lines, "lines");
+
+    uint32_t* starts = malloc((lines + 1) * sizeof(uint32_t));
+    start = bench_now();
+    size_t memchr_lines = memchr_line_starts(text.buffer, text.length, starts);
+    seconds = bench_now() - start;
+    assert(memchr_lines == lines + 1);
+    bench_report("memchr per line", seconds, text.length, "bytes");
+
+    // random offsets, checked against the memchr starts
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    size_t checksum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < lookups; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        size_t offset = (state >> 16) % text.length;
+        SourcePosition position = line_index_position(index, offset);
+        checksum += position.line + position.column;
+    }
+    seconds = bench_now() - start;
+    bench_report("line_index_position", seconds, lookups, "lookups");
+    for (size_t i = 0; i < 1000; i++) {
+        size_t offset = i * (text.length / 1000);
+        SourcePosition position = line_index_position(index, offset);
+        assert(starts[position.line - 1] + position.column - 1 == offset);
+        assert(position.line == lines + 1 || starts[position.line] > offset);
+    }
+
+    size_t rescans = 20;
+    start = bench_now();
+    for (size_t i = 0; i < rescans; i++) {
+        size_t offset = text.length / 2 + i;
+        SourcePosition rescanned = rescan_position(text.buffer, offset);
+        SourcePosition indexed = line_index_position(index, offset);
+        assert(rescanned.line == indexed.line && rescanned.column == indexed.column);
+    }
+    seconds = bench_now() - start;
+    bench_report("rescanning to the middle", seconds, rescans, "lookups");
+    printf("%zu lines, %zu bytes, index %zu bytes (checksum %zu)\n", lines, text.length,
+        line_index_lines_length(index) * sizeof(uint32_t), checksum);
+
+    free(starts);
+    delete_line_index(index);
+    free(text.buffer);
+}
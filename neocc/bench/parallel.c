@@ -0,0 +1,46 @@
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+#include <unistd.h>
+
+static char* compile_with_jobs(Ast* ast, int jobs, double* seconds)
+{
+    double start = bench_now();
+    List* functions = lower(ast, jobs);
+    optimize(functions, jobs);
+    char* assembly = compile(functions, jobs);
+    *seconds = bench_now() - start;
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    return assembly;
+}
+
+int main(int argc, char** argv)
+{
+    size_t functions = bench_arg(argc, argv, 1, 4000);
+    size_t statements = bench_arg(argc, argv, 2, 200);
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_jobs = (int) bench_arg(argc, argv, 3, processors > 2 ? processors : 2);
+
+    char* text = bench_generate_program(functions, statements);
+    Ast* ast = parse(text, strlen(text));
+
+    double baseline_seconds;
+    char* baseline = compile_with_jobs(ast, 1, &baseline_seconds);
+    bench_report("lower+optimize+compile -j1", baseline_seconds, functions + 1, "functions");
+    for (int jobs = 2; jobs <= max_jobs; jobs *= 2) {
+        double seconds;
+        char* assembly = compile_with_jobs(ast, jobs, &seconds);
+        assert(strcmp(assembly, baseline) == 0 && "output depends on the number of jobs");
+        char name[64];
+        snprintf(name, sizeof(name), "lower+optimize+compile -j%d", jobs);
+        bench_report(name, seconds, functions + 1, "functions");
+        printf("    speedup over -j1 %.2fx\n", baseline_seconds / seconds);
+        free(assembly);
+    }
+
+    free(baseline);
+    delete_ast(ast);
+    free(text);
+}
@@ -0,0 +1,37 @@
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+int main(int argc, char** argv)
+{
+    size_t functions = bench_arg(argc, argv, 1, 20000);
+    size_t statements = bench_arg(argc, argv, 2, 50);
+
+    char* text = bench_generate_program(functions, statements);
+    size_t length = strlen(text);
+
+    double start = bench_now();
+    TokenBuffer* tokens = tokenize(text, length);
+    double tokenized = bench_now();
+    size_t token_amount = token_buffer_length(tokens);
+    size_t token_size = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t);
+    size_t buffer_bytes = tokens->m_capacity * token_size;
+    delete_token_buffer(tokens);
+
+    double parse_start = bench_now();
+    Ast* ast = parse(text, length);
+    double parsed = bench_now();
+    size_t definitions = 0;
+    for (AstRef node = ast->statements; node != AST_NONE; node = ast_get(ast, node)->next)
+        definitions++;
+    assert(definitions == functions + 1);
+
+    printf("%zu tokens, bulk token buffer %zu bytes, streaming lookahead %zu bytes (%d tokens)\n", token_amount,
+        buffer_bytes, sizeof(Token) * PARSER_LOOKAHEAD, PARSER_LOOKAHEAD);
+    bench_report("tokenize (bulk)", tokenized - start, token_amount, "tokens");
+    bench_report("lex+parse (streaming)", parsed - parse_start, token_amount, "tokens");
+
+    delete_ast(ast);
+    free(text);
+}
@@ -0,0 +1,102 @@
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+// Values reused across long chains of every operator, so main does real
+// work and some values end up in stack slots.
+static char* generate_mixed_program(size_t values)
+{
+    static const char* operators[] = { "+", "-", "*", "&", "|", "^", "<<", ">>", "<", "==", "/", "%" };
+    BenchText text = { 0 };
+    bench_text_write(&text, "int main()\n{\n    int v0 = 1;\n    int v1 = 2;\n");
+    for (size_t i = 2; i < values; i++) {
+        const char* operator = operators[i % (sizeof(operators) / sizeof(operators[0]))];
+        // shifts and divisions get a small constant right side
+        if (strcmp(operator, "<<") == 0 || strcmp(operator, ">>") == 0 || strcmp(operator, "/") == 0
+            || strcmp(operator, "%") == 0)
+            bench_text_write(&text, "    int v%zu = (v%zu + v%zu) %s %zu;\n", i, i - 1, i / 2, operator, i % 3 + 1);
+        else
+            bench_text_write(&text, "    int v%zu = (v%zu %s v%zu) + %zu;\n", i, i - 1, operator, i / 2, i % 7);
+    }
+    bench_text_write(&text, "    return v%zu;\n}\n", values - 1);
+    return text.buffer;
+}
+
+typedef struct PeepholeResult {
+    size_t instructions;
+    size_t bytes;
+    double seconds;
+    int main_result;
+} PeepholeResult;
+
+static PeepholeResult measure(Ast* ast, bool optimized, int registers, bool peephole, size_t calls)
+{
+    List* functions = lower(ast, 1);
+    if (optimized)
+        optimize(functions, 1);
+    Compiler* compiler = new_compiler(functions);
+    compiler->available_registers = registers;
+    compiler->peephole = peephole;
+    compiler_compile(compiler);
+    Assembly* assembly = compiler->assembly;
+
+    PeepholeResult result = { 0 };
+    for (size_t i = 0; i < assembly_length(assembly); i++)
+        result.instructions += assembly_get(assembly, i)->opcode != OPCODE_LABEL;
+
+    JitCode* code = new_jit_code(assembly);
+    result.bytes = jit_code_length(code);
+    JitFunction main_function = (JitFunction) jit_code_address(code, assembly_label(assembly, "main"));
+    double start = bench_now();
+    for (size_t i = 0; i < calls; i++)
+        result.main_result = main_function();
+    result.seconds = bench_now() - start;
+
+    delete_jit_code(code);
+    delete_compiler(compiler);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    return result;
+}
+
+static void compare(const char* name, Ast* ast, bool optimized, int registers, size_t calls)
+{
+    PeepholeResult before = measure(ast, optimized, registers, false, calls);
+    PeepholeResult after = measure(ast, optimized, registers, true, calls);
+    assert(before.main_result == after.main_result && "peephole changed the result");
+    printf("%s: %zu -> %zu instructions (%+.1f%%), %zu -> %zu bytes (%+.1f%%)\n", name, before.instructions,
+        after.instructions, 100.0 * ((double) after.instructions / before.instructions - 1), before.bytes, after.bytes,
+        100.0 * ((double) after.bytes / before.bytes - 1));
+    if (calls > 0) {
+        bench_report("    main without peephole", before.seconds, calls, "calls");
+        bench_report("    main with peephole", after.seconds, calls, "calls");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t values = bench_arg(argc, argv, 1, 2000);
+    size_t calls = bench_arg(argc, argv, 2, 10000);
+
+    char* functions_text = bench_generate_program(500, 20);
+    char* deep_text = bench_generate_deep_program(100, 200);
+    char* mixed_text = generate_mixed_program(values);
+    Ast* functions_ast = parse(functions_text, strlen(functions_text));
+    Ast* deep_ast = parse(deep_text, strlen(deep_text));
+    Ast* mixed_ast = parse(mixed_text, strlen(mixed_text));
+
+    compare("many functions, optimized", functions_ast, true, 8, 0);
+    compare("many functions, unoptimized", functions_ast, false, 8, 0);
+    compare("deep expressions, unoptimized", deep_ast, false, 8, 0);
+    compare("mixed operators, unoptimized, 8 registers", mixed_ast, false, 8, calls);
+    compare("mixed operators, unoptimized, 2 registers", mixed_ast, false, 2, calls);
+    compare("mixed operators, optimized", mixed_ast, true, 8, calls);
+
+    delete_ast(functions_ast);
+    delete_ast(deep_ast);
+    delete_ast(mixed_ast);
+    free(functions_text);
+    free(deep_text);
+    free(mixed_text);
+}
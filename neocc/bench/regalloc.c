@@ -0,0 +1,77 @@
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+// Long chains where every value is reused much later, so the allocator
+// runs out of registers.
+static char* generate_arithmetic_program(size_t values)
+{
+    BenchText text = { 0 };
+    bench_text_write(&text, "int main()\n{\n    int v0 = 1;\n    int v1 = 2;\n");
+    for (size_t i = 2; i < values; i++)
+        bench_text_write(&text, "    int v%zu = v%zu + v%zu + v%zu + %zu;\n", i, i - 1, i - 2, i / 2, i % 7);
+    bench_text_write(&text, "    return v%zu;\n}\n", values - 1);
+    return text.buffer;
+}
+
+static void bench_registers(Ast* ast, int registers, size_t calls)
+{
+    // unoptimized, folding would leave nothing to allocate
+    List* functions = lower(ast, 1);
+    Compiler* compiler = new_compiler(functions);
+    compiler->available_registers = registers;
+    compiler_compile(compiler);
+    Assembly* assembly = compiler->assembly;
+
+    size_t instructions = 0, memory_operands = 0;
+    for (size_t i = 0; i < assembly_length(assembly); i++) {
+        Instruction* instruction = assembly_get(assembly, i);
+        instructions += instruction->opcode != OPCODE_LABEL;
+        memory_operands += instruction->source.type == OPERAND_TYPE_MEMORY
+            || instruction->destination.type == OPERAND_TYPE_MEMORY;
+    }
+
+    JitCode* code = new_jit_code(assembly);
+    size_t code_length = jit_code_length(code);
+    JitFunction main_function = (JitFunction) jit_code_address(code, assembly_label(assembly, "main"));
+
+    int result = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < calls; i++)
+        result = main_function();
+    double elapsed = bench_now() - start;
+
+    printf("%d registers: %zu instructions, %zu with memory operands, %zu bytes, main() = %d\n",
+        registers, instructions, memory_operands, code_length, result);
+    bench_report("    running main", elapsed, calls, "calls");
+
+    delete_jit_code(code);
+    delete_compiler(compiler);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+}
+
+int main(int argc, char** argv)
+{
+    size_t values = bench_arg(argc, argv, 1, 2000);
+    size_t calls = bench_arg(argc, argv, 2, 10000);
+
+    char* text = generate_arithmetic_program(values);
+    Ast* ast = parse(text, strlen(text));
+
+    double start = bench_now();
+    List* optimized = lower(ast, 1);
+    optimize(optimized, 1);
+    double elapsed = bench_now() - start;
+    bench_report("lower+optimize", elapsed, values, "values");
+    println_and_free(ir_function_to_string(optimized->get(optimized, 0)));
+    list_delete_all_and_self(optimized, (void (*)(void*)) delete_ir_function);
+
+    int register_counts[] = { 8, 4, 2, 0 };
+    for (int i = 0; i < 4; i++)
+        bench_registers(ast, register_counts[i], calls);
+
+    delete_ast(ast);
+    free(text);
+}
@@ -0,0 +1,75 @@
+#define _DEFAULT_SOURCE
+#include "compiler.h"
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static char socket_path[64];
+
+static void* run_server(void* context)
+{
+    serve(socket_path, 1, NULL);
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    size_t files = bench_arg(argc, argv, 1, 500);
+    size_t functions = bench_arg(argc, argv, 2, 20);
+
+    char* text = bench_generate_program(functions, 10);
+    size_t length = strlen(text);
+    snprintf(socket_path, sizeof(socket_path), "/tmp/neocc-bench-%d.sock", (int) getpid());
+
+    pthread_t server;
+    pthread_create(&server, NULL, run_server, NULL);
+    // the server thread may not be listening yet
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strcpy(address.sun_path, socket_path);
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    for (int attempt = 0; attempt < 1000 && connect(connection, (struct sockaddr*) &address, sizeof(address)) != 0; attempt++)
+        usleep(1000);
+
+    double start = bench_now();
+    size_t bytes = 0;
+    for (size_t i = 0; i < files; i++) {
+        size_t executable_length;
+        ServerStatus status;
+        char* executable
+            = server_request(connection, SERVER_REQUEST_EXECUTABLE, text, length, &executable_length, &status);
+        assert(status == SERVER_STATUS_OK && executable_length > 0 && executable[1] == 'E');
+        bytes += executable_length;
+        free(executable);
+    }
+    bench_report("server, one connection", bench_now() - start, files, "files");
+    server_request(connection, SERVER_REQUEST_SHUTDOWN, NULL, 0, NULL, NULL);
+    close(connection);
+    pthread_join(server, NULL);
+
+    // the same files through one neocc process each, when it is built
+    char neocc[4096];
+    if (realpath("neocc", neocc)) {
+        char directory[] = "/tmp/neocc-bench-XXXXXX";
+        char* created = mkdtemp(directory);
+        assert(created && "could not create temporary directory");
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/input.c", directory);
+        write_file(path, text);
+        char command[8192];
+        snprintf(command, sizeof(command), "cd %s && %s --direct input.c", directory, neocc);
+        size_t processes = files / 10 > 0 ? files / 10 : 1;
+        start = bench_now();
+        for (size_t i = 0; i < processes; i++) {
+            int exit_code = system(command);
+            assert(exit_code == 0);
+        }
+        bench_report("one neocc --direct process per file", bench_now() - start, processes, "files");
+        bench_remove_directory(directory);
+    }
+    free(text);
+}
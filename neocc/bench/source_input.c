@@ -0,0 +1,56 @@
+#include "utils.h"
+#include "bench.h"
+#include <assert.h>
+
+static const char* path = "bench/source_input.tmp";
+
+static void write_source(size_t megabytes)
+{
+    FILE* fp = fopen(path, "w");
+    assert(fp && "could not create input");
+    const char* line = "    int value = 1234 + other_value + 3;\n";
+    size_t line_length = strlen(line);
+    for (size_t written = 0; written < megabytes << 20; written += line_length)
+        fputs(line, fp);
+    fclose(fp);
+}
+
+// touches every byte, so lazily mapped pages are paid for too
+static size_t checksum(const char* text, size_t length)
+{
+    size_t sum = 0;
+    for (size_t i = 0; i < length; i++)
+        sum += (unsigned char) text[i];
+    return sum;
+}
+
+int main(int argc, char** argv)
+{
+    size_t megabytes = bench_arg(argc, argv, 1, 256);
+    write_source(megabytes);
+
+    double start = bench_now();
+    char* content = read_file(path);
+    double read_seconds = bench_now() - start;
+    size_t length = strlen(content);
+    size_t read_sum = checksum(content, length);
+    double read_total_seconds = bench_now() - start;
+    free(content);
+
+    start = bench_now();
+    MappedFile* file = new_mapped_file(path);
+    double map_seconds = bench_now() - start;
+    assert(file->text[file->length] == '\0');
+    size_t map_sum = checksum(file->text, file->length);
+    double map_total_seconds = bench_now() - start;
+    assert(read_sum == map_sum && file->length == length);
+    delete_mapped_file(file);
+
+    printf("%zu MB input\n", megabytes);
+    bench_report("read_file", read_seconds, length >> 20, "MB");
+    bench_report("read_file + pass over text", read_total_seconds, length >> 20, "MB");
+    bench_report("new_mapped_file", map_seconds, length >> 20, "MB");
+    bench_report("new_mapped_file + pass over text", map_total_seconds, length >> 20, "MB");
+
+    remove(path);
+}
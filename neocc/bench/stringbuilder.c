@@ -0,0 +1,57 @@
+#include "utils.h"
+#include "bench.h"
+
+static double bench_previous_strcat(size_t target_bytes)
+{
+    // how string_builder_write used to append: exact realloc, memset, strcat
+    double start = bench_now();
+    size_t length = 0;
+    char* buffer = calloc(1, sizeof(char));
+    const char* line = "    movl $42, %eax\n";
+    size_t line_length = strlen(line);
+    while (length < target_bytes) {
+        size_t old_length = length;
+        length += line_length;
+        buffer = realloc(buffer, length + 1);
+        memset(buffer + old_length, '\0', length - old_length + 1);
+        strcat(buffer, line);
+    }
+    free(buffer);
+    return bench_now() - start;
+}
+
+static double bench_emit_assembly(size_t target_bytes, size_t* emitted)
+{
+    double start = bench_now();
+    StringBuilder* sb = new_string_builder();
+    for (int i = 0; string_builder_length(sb) < target_bytes; i++) {
+        string_builder_write_fmt(sb, "function_%d:\n", i);
+        string_builder_write(sb, "    pushq %rbp\n");
+        string_builder_write(sb, "    movq %rsp, %rbp\n");
+        string_builder_write_fmt(sb, "    movl $%d, %%eax\n", i);
+        string_builder_write_fmt(sb, "    jmp .function_%d_end\n", i);
+        string_builder_write_fmt(sb, ".function_%d_end:\n", i);
+        string_builder_write_n(sb, "    popq %rbp\n", 14);
+        string_builder_write(sb, "    ret");
+        string_builder_write_char(sb, '\n');
+    }
+    *emitted = string_builder_length(sb);
+    char* assembly = string_builder_take(sb);
+    delete_string_builder(sb);
+    double elapsed = bench_now() - start;
+    free(assembly);
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    size_t megabytes = bench_arg(argc, argv, 1, 100);
+    size_t previous_megabytes = bench_arg(argc, argv, 2, 1);
+
+    size_t emitted;
+    double elapsed = bench_emit_assembly(megabytes * 1024 * 1024, &emitted);
+    bench_report("emit assembly, StringBuilder", elapsed, emitted, "bytes");
+
+    size_t previous_bytes = previous_megabytes * 1024 * 1024;
+    bench_report("previous strcat growth (smaller input)", bench_previous_strcat(previous_bytes), previous_bytes, "bytes");
+}
@@ -0,0 +1,242 @@
+#include "assembly.h"
+#include "parser.h"
+#include "utils.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FunctionCache* new_function_cache(const char* directory)
+{
+    static_assert(sizeof(FunctionCache) == 24, "incomplete construction of FunctionCache");
+    int error = mkdir(directory, 0755);
+    assert((error == 0 || errno == EEXIST) && "could not create cache directory");
+    FunctionCache* self = counted_calloc(1, sizeof(FunctionCache));
+    *self = (FunctionCache) {
+        .directory = copy_string(directory),
+        .hits = 0,
+        .misses = 0,
+    };
+    return self;
+}
+
+void delete_function_cache(FunctionCache* self)
+{
+    free(self->directory);
+    free(self);
+}
+
+static void entry_path(FunctionCache* self, uint64_t key, char* path, size_t path_length)
+{
+    snprintf(path, path_length, "%s/%016lx.fn", self->directory, key);
+}
+
+Assembly* function_cache_load(FunctionCache* self, uint64_t key)
+{
+    char path[4096];
+    entry_path(self, key, path, sizeof(path));
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        atomic_fetch_add_explicit(&self->misses, 1, memory_order_relaxed);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    size_t length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* bytes = counted_malloc(length + 1);
+    size_t read = fread(bytes, 1, length, fp);
+    fclose(fp);
+    // a damaged entry is a miss, and is overwritten after compiling
+    Assembly* assembly = read == length ? new_assembly_from_bytes(bytes, length) : NULL;
+    free(bytes);
+    atomic_fetch_add_explicit(assembly ? &self->hits : &self->misses, 1, memory_order_relaxed);
+    return assembly;
+}
+
+// Writes head and body to a temporary file next to path and renames it
+// over path, so concurrent runs and threads never read half an entry. The
+// temporary name is unique per call. Entries of the same key have the same
+// content, so when another writer wins the rename this one is simply dropped.
+static void write_entry(const char* path, const void* head, size_t head_length, const void* body, size_t body_length)
+{
+    char temporary_path[4096 + 16];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.XXXXXX", path);
+    int fd = mkstemp(temporary_path);
+    assert(fd >= 0 && "could not write cache entry");
+    // mkstemp makes the file private, entries are as readable as the directory
+    fchmod(fd, 0644);
+    FILE* fp = fdopen(fd, "wb");
+    assert(fp && "could not write cache entry");
+    bool written = fwrite(head, 1, head_length, fp) == head_length && fwrite(body, 1, body_length, fp) == body_length;
+    written = fclose(fp) == 0 && written;
+    if (!written || rename(temporary_path, path) != 0)
+        unlink(temporary_path);
+}
+
+void function_cache_store(FunctionCache* self, uint64_t key, Assembly* assembly)
+{
+    StringBuilder* bytes = new_string_builder();
+    assembly_write(assembly, bytes);
+    char path[4096];
+    entry_path(self, key, path, sizeof(path));
+    write_entry(path, string_builder_buffer(bytes), string_builder_length(bytes), NULL, 0);
+    delete_string_builder(bytes);
+}
+
+#define AST_CACHE_MAGIC 0x5453414e
+
+// The start of an AstCache entry, followed by nodes_length AstNodes.
+typedef struct AstCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t source_length;
+    uint32_t nodes_length;
+    AstRef statements;
+} AstCacheHeader;
+
+AstCache* new_ast_cache(const char* directory)
+{
+    static_assert(sizeof(AstCache) == 24, "incomplete construction of AstCache");
+    static_assert(sizeof(AstCacheHeader) % _Alignof(AstNode) == 0, "AstCache nodes would be unaligned");
+    int error = mkdir(directory, 0755);
+    assert((error == 0 || errno == EEXIST) && "could not create cache directory");
+    AstCache* self = counted_calloc(1, sizeof(AstCache));
+    *self = (AstCache) {
+        .directory = copy_string(directory),
+        .hits = 0,
+        .misses = 0,
+    };
+    return self;
+}
+
+void delete_ast_cache(AstCache* self)
+{
+    free(self->directory);
+    free(self);
+}
+
+static void ast_entry_path(AstCache* self, uint64_t key, char* path, size_t path_length)
+{
+    snprintf(path, path_length, "%s/%016lx.ast", self->directory, key);
+}
+
+// Whether every node of an entry refers to nodes and text that exist, so
+// that a damaged entry can't make the compiler read outside of either.
+// The parser adds a node after its first and second children and before
+// the node its next refers to, so children point back and next forward.
+// Every node but node 0 must also be reached exactly once from statements,
+// so walking the tree visits each node once and cycles can't be mapped in.
+static bool ast_cache_nodes_valid(const AstNode* nodes, uint32_t nodes_length, AstRef statements, size_t length)
+{
+    for (uint32_t i = 0; i < nodes_length; i++) {
+        const AstNode* node = &nodes[i];
+        if (node->kind > AST_KIND_INT || node->token_type > TOKEN_TYPE_EOF
+            || node->operation_type > BINARY_OPERATION_TYPE_LOGICAL_OR || node->offset > length
+            || node->length > length - node->offset)
+            return false;
+        if ((node->first != AST_NONE && node->first >= i) || (node->second != AST_NONE && node->second >= i)
+            || (node->next != AST_NONE && (node->next <= i || node->next >= nodes_length)))
+            return false;
+    }
+
+    bool* reached = counted_calloc(nodes_length, sizeof(bool));
+    AstRef* pending = counted_malloc(nodes_length * sizeof(AstRef));
+    size_t pending_length = 0;
+    uint32_t reached_length = 0;
+    bool valid = true;
+    if (statements != AST_NONE) {
+        reached[statements] = true;
+        reached_length++;
+        pending[pending_length++] = statements;
+    }
+    while (valid && pending_length > 0) {
+        const AstNode* node = &nodes[pending[--pending_length]];
+        AstRef refs[] = { node->first, node->second, node->next };
+        for (size_t i = 0; i < sizeof(refs) / sizeof(refs[0]); i++) {
+            if (refs[i] == AST_NONE)
+                continue;
+            if (reached[refs[i]]) {
+                valid = false;
+                break;
+            }
+            reached[refs[i]] = true;
+            reached_length++;
+            pending[pending_length++] = refs[i];
+        }
+    }
+    free(pending);
+    free(reached);
+    return valid && reached_length == nodes_length - 1;
+}
+
+Ast* ast_cache_load(AstCache* self, const char* text, size_t length)
+{
+    uint64_t key = hash_chars(text, length);
+    char path[4096];
+    ast_entry_path(self, key, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(AstCacheHeader)) {
+        if (fd >= 0)
+            close(fd);
+        atomic_fetch_add_explicit(&self->misses, 1, memory_order_relaxed);
+        return NULL;
+    }
+    size_t mapping_length = status.st_size;
+    void* mapping = mmap(NULL, mapping_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        atomic_fetch_add_explicit(&self->misses, 1, memory_order_relaxed);
+        return NULL;
+    }
+    // A damaged entry is a miss, and is overwritten after parsing. Entries
+    // are only told apart by the hash and length of their source, a
+    // different source of the same length and hash would be given this AST.
+    const AstCacheHeader* header = mapping;
+    if (header->magic != AST_CACHE_MAGIC || header->version != AST_CACHE_VERSION || header->source_hash != key
+        || header->source_length != length || header->nodes_length == 0 || header->statements >= header->nodes_length
+        || mapping_length != sizeof(AstCacheHeader) + (size_t) header->nodes_length * sizeof(AstNode)
+        || !ast_cache_nodes_valid((const AstNode*) (header + 1), header->nodes_length, header->statements, length)) {
+        munmap(mapping, mapping_length);
+        atomic_fetch_add_explicit(&self->misses, 1, memory_order_relaxed);
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&self->hits, 1, memory_order_relaxed);
+    return new_mapped_ast(text, header->statements, (const AstNode*) (header + 1), header->nodes_length, mapping,
+        mapping_length);
+}
+
+void ast_cache_store(AstCache* self, Ast* ast, size_t length)
+{
+    uint64_t key = hash_chars(ast->text, length);
+    AstCacheHeader header = {
+        .magic = AST_CACHE_MAGIC,
+        .version = AST_CACHE_VERSION,
+        .source_hash = key,
+        .source_length = length,
+        .nodes_length = ast_length(ast),
+        .statements = ast->statements,
+    };
+
+    char path[4096];
+    ast_entry_path(self, key, path, sizeof(path));
+    write_entry(path, &header, sizeof(header), ast->nodes, sizeof(AstNode) * ast_length(ast));
+}
+
+Ast* parse_file_cached(MappedFile* source, AstCache* cache)
+{
+    if (!cache)
+        return parse_file(source);
+    Ast* ast = ast_cache_load(cache, source->text, source->length);
+    if (ast)
+        return ast;
+    ast = parse_file(source);
+    ast_cache_store(cache, ast, source->length);
+    return ast;
+}
@@ -1,114 +1,371 @@
 #include "compiler.h"
+#include "assembly.h"
 #include "parser.h"
 #include "utils.h"
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-Compiler* new_compiler(List* ast)
+static const Register allocatable_registers[] = {
+    REGISTER_RCX,
+    REGISTER_RDX,
+    REGISTER_RSI,
+    REGISTER_RDI,
+    REGISTER_R8,
+    REGISTER_R9,
+    REGISTER_R10,
+    REGISTER_R11,
+};
+#define ALLOCATABLE_REGISTERS_LENGTH (int) (sizeof(allocatable_registers) / sizeof(allocatable_registers[0]))
+
+Compiler* new_compiler(List* functions)
 {
-    static_assert(sizeof(Compiler) == 32, "incomplete construction of Compiler");
-    Compiler* self = calloc(1, sizeof(Compiler));
+    static_assert(sizeof(Compiler) == 48, "incomplete construction of Compiler");
+    Compiler* self = counted_calloc(1, sizeof(Compiler));
     *self = (Compiler) {
-        .ast = ast,
-        .assembly = new_string_builder(),
-        .inside_function = false,
-        .current_function_name = NULL,
+        .functions = functions,
+        .assembly = new_assembly(),
+        .function = NULL,
+        .function_end_label = -1,
+        .available_registers = ALLOCATABLE_REGISTERS_LENGTH,
+        .jobs = 1,
+        .peephole = true,
+        .allocation = NULL,
     };
     return self;
 }
 
 void delete_compiler(Compiler* self)
 {
-    delete_string_builder(self->assembly);
+    if (self->assembly)
+        delete_assembly(self->assembly);
     free(self);
 }
 
-char* compiler_compile(Compiler* self)
+static inline void emit(Compiler* self, Opcode opcode, int size, Operand source, Operand destination)
+{
+    assembly_add(self->assembly, opcode, size, source, destination);
+}
+
+typedef struct CompileJob {
+    Compiler* compiler;
+    Assembly** assemblies;
+} CompileJob;
+
+static void compile_function_job(void* context, size_t index)
+{
+    CompileJob* job = context;
+    IrFunction* function = job->compiler->functions->get(job->compiler->functions, index);
+    if (function->cached_assembly) {
+        // there is no IR to compile differently, lower without a cache instead
+        assert(job->compiler->available_registers == ALLOCATABLE_REGISTERS_LENGTH && job->compiler->peephole
+            && "cached assembly used with non-default registers or passes");
+        job->assemblies[index] = new_assembly();
+        assembly_append(job->assemblies[index], function->cached_assembly);
+        return;
+    }
+    Compiler* compiler = new_compiler(job->compiler->functions);
+    compiler->available_registers = job->compiler->available_registers;
+    compiler_make_function(compiler, function);
+    if (job->compiler->peephole)
+        peephole(compiler->assembly);
+    // the cached code is only right for the default registers and passes
+    if (function->cache && compiler->available_registers == ALLOCATABLE_REGISTERS_LENGTH && job->compiler->peephole)
+        function_cache_store(function->cache, function->source_hash, compiler->assembly);
+    job->assemblies[index] = compiler->assembly;
+    compiler->assembly = NULL;
+    delete_compiler(compiler);
+}
+
+void compiler_compile(Compiler* self)
 {
-    string_builder_write(self->assembly, ".global _start\n");
-    string_builder_write(self->assembly, ".text\n");
-    string_builder_write(self->assembly, "_start:\n");
-    string_builder_write(self->assembly, "    call main\n");
-    string_builder_write(self->assembly, "    jmp end\n");
-    compiler_make_statements(self, self->ast);
-    string_builder_write(self->assembly, "end:\n");
-    string_builder_write(self->assembly, "    mov %rax, %rbx\n");
-    string_builder_write(self->assembly, "    mov $1, %rax\n");
-    string_builder_write(self->assembly, "    int $0x80\n");
+    // a '.' in the middle can't come from a C name or a function's block labels
+    int end = assembly_label(self->assembly, ".neocc.end");
+    assembly_place_label(self->assembly, assembly_label(self->assembly, "_start"));
+    emit(self, OPCODE_CALL, 8, operand_label(assembly_label(self->assembly, "main")), operand_none());
+    emit(self, OPCODE_JMP, 8, operand_label(end), operand_none());
+
+    // every function is compiled into its own Assembly, then appended in
+    // order so the output doesn't depend on the number of jobs
+    size_t length = self->functions->length(self->functions);
+    Assembly** assemblies = counted_calloc(length + 1, sizeof(Assembly*));
+    parallel_for(length, self->jobs, compile_function_job, &(CompileJob) { self, assemblies });
+    for (size_t i = 0; i < length; i++) {
+        assembly_append(self->assembly, assemblies[i]);
+        delete_assembly(assemblies[i]);
+    }
+    free(assemblies);
 
-    return string_builder_c_string(self->assembly);
+    assembly_place_label(self->assembly, end);
+    emit(self, OPCODE_MOV, 8, operand_register(REGISTER_RAX), operand_register(REGISTER_RBX));
+    emit(self, OPCODE_MOV, 8, operand_immediate(1), operand_register(REGISTER_RAX));
+    emit(self, OPCODE_INT, 0, operand_immediate(0x80), operand_none());
 }
 
-void compiler_make_statements(Compiler* self, List* statements)
+static int block_label(Compiler* self, int block)
 {
-    for (int i = 0; i < statements->length(statements); i++)
-        compiler_make_statement(self, statements->get(statements, i));
+    char name[64];
+    snprintf(name, sizeof(name), ".%s_b%d", self->function->name, block);
+    return assembly_label(self->assembly, name);
 }
 
-void compiler_make_statement(Compiler* self, StatementNode* node)
+void compiler_make_function(Compiler* self, IrFunction* function)
 {
-    switch (node->node_type) {
-    case STATEMENT_TYPE_FUNC_DEF:
-        return compiler_make_function_definition(self, (FuncDefNode*) node);
-    case STATEMENT_TYPE_RETURN:
-        return compiler_make_return(self, (ReturnNode*) node);
-    case STATEMENT_TYPE_EXPRESSION:
-    default:
-        assert(!"unexpected StatementNodeType");
+    lower_phis(function);
+    int available = self->available_registers < ALLOCATABLE_REGISTERS_LENGTH
+        ? self->available_registers
+        : ALLOCATABLE_REGISTERS_LENGTH;
+    self->allocation = allocate_registers(function, allocatable_registers, available);
+
+    char* end_name = counted_calloc(strlen(function->name) + 6, sizeof(char));
+    sprintf(end_name, ".%s_end", function->name);
+
+    self->function = function;
+    self->function_end_label = assembly_label(self->assembly, end_name);
+
+    // spill slots are 8 bytes, and the stack stays 16 byte aligned
+    int frame_size = (self->allocation->spill_slots * 8 + 15) & ~15;
+
+    assembly_place_label(self->assembly, assembly_label(self->assembly, function->name));
+    emit(self, OPCODE_PUSH, 8, operand_register(REGISTER_RBP), operand_none());
+    emit(self, OPCODE_MOV, 8, operand_register(REGISTER_RSP), operand_register(REGISTER_RBP));
+    if (frame_size > 0)
+        emit(self, OPCODE_SUB, 8, operand_immediate(frame_size), operand_register(REGISTER_RSP));
+    for (int i = 0; i < function->blocks->length(function->blocks); i++) {
+        IrBlock* block = ir_function_block(function, i);
+        if (block->removed)
+            continue;
+        if (i != 0)
+            assembly_place_label(self->assembly, block_label(self, block->id));
+        for (size_t j = 0; j < ir_block_length(block); j++)
+            compiler_make_ir_instruction(self, ir_block_get(block, j));
     }
+    assembly_place_label(self->assembly, self->function_end_label);
+    if (frame_size > 0)
+        emit(self, OPCODE_MOV, 8, operand_register(REGISTER_RBP), operand_register(REGISTER_RSP));
+    emit(self, OPCODE_POP, 8, operand_register(REGISTER_RBP), operand_none());
+    emit(self, OPCODE_RET, 8, operand_none(), operand_none());
+
+    self->function = NULL;
+    self->function_end_label = -1;
+
+    free(end_name);
+    delete_register_allocation(self->allocation);
+    self->allocation = NULL;
+}
+
+static inline Operand location(Compiler* self, int reg)
+{
+    return self->allocation->locations[reg];
+}
+
+static inline bool operand_equals(Operand a, Operand b)
+{
+    return a.type == b.type && a.reg == b.reg && a.value == b.value;
 }
 
-void compiler_make_function_definition(Compiler* self, FuncDefNode* node)
+// mov between two locations, through %eax if both are stack slots
+static void move(Compiler* self, Operand source, Operand destination)
 {
-    char* name = chars_to_string(node->target->value, node->target->length);
+    if (operand_equals(source, destination))
+        return;
+    if (source.type == OPERAND_TYPE_MEMORY && destination.type == OPERAND_TYPE_MEMORY) {
+        emit(self, OPCODE_MOV, 4, source, operand_register(REGISTER_RAX));
+        source = operand_register(REGISTER_RAX);
+    }
+    emit(self, OPCODE_MOV, 4, source, destination);
+}
 
-    self->inside_function = true;
-    self->current_function_name = name;
+void compiler_make_ir_instruction(Compiler* self, IrInstruction* instruction)
+{
+    assert(self->function);
+    switch (instruction->opcode) {
+    case IR_OPCODE_NOP:
+    case IR_OPCODE_CONST:
+        // constants are immediates at their uses
+        break;
+    case IR_OPCODE_COPY:
+        move(self, location(self, instruction->left), location(self, instruction->destination));
+        break;
+    case IR_OPCODE_ADD:
+        compiler_make_arithmetic(self, instruction, OPCODE_ADD, true);
+        break;
+    case IR_OPCODE_SUB:
+        compiler_make_arithmetic(self, instruction, OPCODE_SUB, false);
+        break;
+    case IR_OPCODE_AND:
+        compiler_make_arithmetic(self, instruction, OPCODE_AND, true);
+        break;
+    case IR_OPCODE_OR:
+        compiler_make_arithmetic(self, instruction, OPCODE_OR, true);
+        break;
+    case IR_OPCODE_XOR:
+        compiler_make_arithmetic(self, instruction, OPCODE_XOR, true);
+        break;
+    case IR_OPCODE_MUL:
+        compiler_make_multiplication(self, instruction);
+        break;
+    case IR_OPCODE_DIV:
+    case IR_OPCODE_MOD:
+        compiler_make_division(self, instruction);
+        break;
+    case IR_OPCODE_SHL:
+        compiler_make_shift(self, instruction, OPCODE_SHL);
+        break;
+    case IR_OPCODE_SHR:
+        compiler_make_shift(self, instruction, OPCODE_SAR);
+        break;
+    case IR_OPCODE_EQ:
+        compiler_make_comparison(self, instruction, OPCODE_SETE);
+        break;
+    case IR_OPCODE_NE:
+        compiler_make_comparison(self, instruction, OPCODE_SETNE);
+        break;
+    case IR_OPCODE_LT:
+        compiler_make_comparison(self, instruction, OPCODE_SETL);
+        break;
+    case IR_OPCODE_LE:
+        compiler_make_comparison(self, instruction, OPCODE_SETLE);
+        break;
+    case IR_OPCODE_GT:
+        compiler_make_comparison(self, instruction, OPCODE_SETG);
+        break;
+    case IR_OPCODE_GE:
+        compiler_make_comparison(self, instruction, OPCODE_SETGE);
+        break;
+    case IR_OPCODE_JUMP:
+        emit(self, OPCODE_JMP, 8, operand_label(block_label(self, instruction->value)), operand_none());
+        break;
+    case IR_OPCODE_BRANCH:
+        compiler_make_branch(self, instruction);
+        break;
+    case IR_OPCODE_RETURN:
+        move(self, location(self, instruction->left), operand_register(REGISTER_RAX));
+        emit(self, OPCODE_JMP, 8, operand_label(self->function_end_label), operand_none());
+        break;
+    case IR_OPCODE_PHI:
+        assert(!"phi left after lower_phis");
+    }
+}
 
-    string_builder_write(self->assembly, name);
-    string_builder_write(self->assembly, ":\n");
-    string_builder_write(self->assembly, "    pushq %rbp\n");
-    string_builder_write(self->assembly, "    movq %rsp, %rbp\n");
-    compiler_make_statements(self, node->body);
-    string_builder_write_fmt(self->assembly, ".%s_end:\n", name);
-    string_builder_write(self->assembly, "    popq %rbp\n");
-    string_builder_write(self->assembly, "    ret\n");
+void compiler_make_arithmetic(Compiler* self, IrInstruction* instruction, Opcode opcode, bool commutative)
+{
+    Operand destination = location(self, instruction->destination);
+    Operand left = location(self, instruction->left);
+    Operand right = location(self, instruction->right);
+    if (destination.type == OPERAND_TYPE_MEMORY || (operand_equals(destination, right) && !commutative)) {
+        move(self, left, operand_register(REGISTER_RAX));
+        emit(self, opcode, 4, right, operand_register(REGISTER_RAX));
+        move(self, operand_register(REGISTER_RAX), destination);
+    } else if (operand_equals(destination, right)) {
+        // the result took over the right operand's register
+        emit(self, opcode, 4, left, destination);
+    } else {
+        move(self, left, destination);
+        emit(self, opcode, 4, right, destination);
+    }
+}
 
-    self->inside_function = false;
-    self->current_function_name = NULL;
-    
-    free(name);
+void compiler_make_multiplication(Compiler* self, IrInstruction* instruction)
+{
+    // imul only multiplies into a register
+    move(self, location(self, instruction->left), operand_register(REGISTER_RAX));
+    emit(self, OPCODE_IMUL, 4, location(self, instruction->right), operand_register(REGISTER_RAX));
+    move(self, operand_register(REGISTER_RAX), location(self, instruction->destination));
 }
 
-void compiler_make_return(Compiler* self, ReturnNode* node)
+// idiv takes the dividend in %edx:%eax and the divisor in anything but an
+// immediate, and %ecx and %edx are allocatable, so both are saved around it.
+void compiler_make_division(Compiler* self, IrInstruction* instruction)
 {
-    assert(self->inside_function);
-    compiler_make_expression(self, node->value);
-    string_builder_write_fmt(self->assembly, "    jmp .%s_end\n", self->current_function_name);
+    Operand divisor = location(self, instruction->right);
+    emit(self, OPCODE_PUSH, 8, operand_register(REGISTER_RCX), operand_none());
+    emit(self, OPCODE_PUSH, 8, operand_register(REGISTER_RDX), operand_none());
+    move(self, location(self, instruction->left), operand_register(REGISTER_RAX));
+    if (divisor.type != OPERAND_TYPE_MEMORY) {
+        move(self, divisor, operand_register(REGISTER_RCX));
+        divisor = operand_register(REGISTER_RCX);
+    }
+    emit(self, OPCODE_CLTD, 4, operand_none(), operand_none());
+    emit(self, OPCODE_IDIV, 4, divisor, operand_none());
+    if (instruction->opcode == IR_OPCODE_MOD)
+        emit(self, OPCODE_MOV, 4, operand_register(REGISTER_RDX), operand_register(REGISTER_RAX));
+    emit(self, OPCODE_POP, 8, operand_register(REGISTER_RDX), operand_none());
+    emit(self, OPCODE_POP, 8, operand_register(REGISTER_RCX), operand_none());
+    move(self, operand_register(REGISTER_RAX), location(self, instruction->destination));
 }
 
-void compiler_make_expression(Compiler* self, ExpressionNode* node)
+// A shift count which isn't an immediate has to be in %cl.
+void compiler_make_shift(Compiler* self, IrInstruction* instruction, Opcode opcode)
 {
-    switch (node->node_type) {
-    case EXPRESSION_TYPE_INT:
-        return compiler_make_int_literal(self, (IntNode*) node);
-    default:
-        assert(!"unexpected ExpressionNodeType");
+    Operand count = location(self, instruction->right);
+    move(self, location(self, instruction->left), operand_register(REGISTER_RAX));
+    if (count.type == OPERAND_TYPE_IMMEDIATE) {
+        emit(self, opcode, 4, operand_immediate(count.value & 31), operand_register(REGISTER_RAX));
+    } else {
+        emit(self, OPCODE_PUSH, 8, operand_register(REGISTER_RCX), operand_none());
+        move(self, count, operand_register(REGISTER_RCX));
+        emit(self, opcode, 4, operand_register(REGISTER_RCX), operand_register(REGISTER_RAX));
+        emit(self, OPCODE_POP, 8, operand_register(REGISTER_RCX), operand_none());
     }
+    move(self, operand_register(REGISTER_RAX), location(self, instruction->destination));
+}
+
+void compiler_make_comparison(Compiler* self, IrInstruction* instruction, Opcode set)
+{
+    move(self, location(self, instruction->left), operand_register(REGISTER_RAX));
+    emit(self, OPCODE_CMP, 4, location(self, instruction->right), operand_register(REGISTER_RAX));
+    emit(self, set, 1, operand_register(REGISTER_RAX), operand_none());
+    emit(self, OPCODE_MOVZB, 4, operand_register(REGISTER_RAX), operand_register(REGISTER_RAX));
+    move(self, operand_register(REGISTER_RAX), location(self, instruction->destination));
 }
 
-void compiler_make_int_literal(Compiler* self, IntNode* node)
+// jne to the block taken on not 0 and jmp to the other one, which the
+// peephole pass drops when that block comes next.
+void compiler_make_branch(Compiler* self, IrInstruction* instruction)
 {
-    char* value_string = chars_to_string(node->token->value, node->token->length);
-    int value = atoi(value_string);
-    free(value_string);
-    string_builder_write_fmt(self->assembly, "    movl $%d, %%eax\n", value);
+    Operand condition = location(self, instruction->left);
+    if (condition.type == OPERAND_TYPE_IMMEDIATE) {
+        int taken = condition.value != 0 ? instruction->value : instruction->right;
+        emit(self, OPCODE_JMP, 8, operand_label(block_label(self, taken)), operand_none());
+        return;
+    }
+    emit(self, OPCODE_CMP, 4, operand_immediate(0), condition);
+    emit(self, OPCODE_JNE, 8, operand_label(block_label(self, instruction->value)), operand_none());
+    emit(self, OPCODE_JMP, 8, operand_label(block_label(self, instruction->right)), operand_none());
 }
 
-char* compile(List* ast)
+Assembly* compile_to_assembly(List* functions, int jobs)
 {
-    Compiler* compiler = new_compiler(ast);
-    char* result = compiler_compile(compiler);
+    Compiler* compiler = new_compiler(functions);
+    compiler->jobs = jobs;
+    compiler_compile(compiler);
+    Assembly* result = compiler->assembly;
+    compiler->assembly = NULL;
     delete_compiler(compiler);
     return result;
 }
+
+char* compile(List* functions, int jobs)
+{
+    Assembly* assembly = compile_to_assembly(functions, jobs);
+    char* result = assembly_to_string(assembly);
+    delete_assembly(assembly);
+    return result;
+}
+
+void compile_to_executable_bytes(List* functions, int jobs, StringBuilder* bytes)
+{
+    Assembly* assembly = compile_to_assembly(functions, jobs);
+    assembly_write_executable(assembly, bytes);
+    delete_assembly(assembly);
+}
+
+void compile_to_executable(List* functions, int jobs, const char* path)
+{
+    StringBuilder* bytes = new_string_builder();
+    compile_to_executable_bytes(functions, jobs, bytes);
+    write_executable_file(path, string_builder_buffer(bytes), string_builder_length(bytes));
+    delete_string_builder(bytes);
+}
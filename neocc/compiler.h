@@ -1,24 +1,83 @@
 #pragma once
 
 #include <stdbool.h>
+#include "assembly.h"
+#include "ir.h"
 #include "utils.h"
 #include "parser.h"
 
 typedef struct Compiler {
-    List* ast;
-    StringBuilder* assembly;
-    bool inside_function;
-    char* current_function_name;
+    List* functions;
+    Assembly* assembly;
+    IrFunction* function;
+    int function_end_label;
+    // how many of the allocatable registers may be used, the rest spills
+    int available_registers;
+    // functions are compiled on up to this many threads
+    int jobs;
+    // runs peephole over every function, on unless comparing against it
+    bool peephole;
+    RegisterAllocation* allocation;
 } Compiler;
 
-Compiler* new_compiler(List* ast);
+// Compiles a list of IrFunction, lowering their phis in place.
+Compiler* new_compiler(List* functions);
 void delete_compiler(Compiler* self);
-char* compiler_compile(Compiler* self);
-void compiler_make_statements(Compiler* self, List* statements);
-void compiler_make_statement(Compiler* self, StatementNode* node);
-void compiler_make_function_definition(Compiler* self, FuncDefNode* node);
-void compiler_make_return(Compiler* self, ReturnNode* node);
-void compiler_make_expression(Compiler* self, ExpressionNode* node);
-void compiler_make_int_literal(Compiler* self, IntNode* node);
-
-char* compile(List* ast);
+void compiler_compile(Compiler* self);
+void compiler_make_function(Compiler* self, IrFunction* function);
+void compiler_make_ir_instruction(Compiler* self, IrInstruction* instruction);
+void compiler_make_arithmetic(Compiler* self, IrInstruction* instruction, Opcode opcode, bool commutative);
+void compiler_make_multiplication(Compiler* self, IrInstruction* instruction);
+void compiler_make_division(Compiler* self, IrInstruction* instruction);
+void compiler_make_shift(Compiler* self, IrInstruction* instruction, Opcode opcode);
+void compiler_make_comparison(Compiler* self, IrInstruction* instruction, Opcode set);
+void compiler_make_branch(Compiler* self, IrInstruction* instruction);
+
+Assembly* compile_to_assembly(List* functions, int jobs);
+char* compile(List* functions, int jobs);
+// Appends the bytes of a static executable.
+void compile_to_executable_bytes(List* functions, int jobs, StringBuilder* bytes);
+void compile_to_executable(List* functions, int jobs, const char* path);
+
+// neocc --server compiles translation units sent over a Unix socket. Every
+// request is a ServerRequest followed by length bytes of source, and is
+// answered by a ServerResponse followed by length bytes of output, as
+// many times as the client wants on one connection. A source the compiler
+// rejects is answered with SERVER_STATUS_ERROR and the diagnostics as
+// output, and the connection stays open. Every request is compiled in its
+// own forked child, so requests share nothing but the function cache.
+typedef enum ServerRequestKind {
+    SERVER_REQUEST_EXECUTABLE,
+    SERVER_REQUEST_ASSEMBLY,
+    // stops accepting connections, the server exits once the others close
+    SERVER_REQUEST_SHUTDOWN,
+} ServerRequestKind;
+
+// sources are limited like the parser's token offsets, longer requests
+// close the connection
+#define SERVER_MAX_SOURCE_LENGTH UINT32_MAX
+
+typedef struct ServerRequest {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t length;
+} ServerRequest;
+
+typedef enum ServerStatus {
+    SERVER_STATUS_OK,
+    SERVER_STATUS_ERROR,
+} ServerStatus;
+
+typedef struct ServerResponse {
+    uint32_t status;
+    uint32_t reserved;
+    uint64_t length;
+} ServerResponse;
+
+void serve(const char* socket_path, int jobs, FunctionCache* cache);
+int server_connect(const char* socket_path);
+// Sends one translation unit and returns the newly allocated output, or NULL
+// for SERVER_REQUEST_SHUTDOWN. When status is SERVER_STATUS_ERROR the output
+// is the compiler's diagnostics.
+char* server_request(int connection, ServerRequestKind kind, const char* source, size_t source_length, size_t* length,
+    ServerStatus* status);
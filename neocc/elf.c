@@ -0,0 +1,74 @@
+#include "assembly.h"
+#include <assert.h>
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define ELF_LOAD_ADDRESS 0x400000
+
+// Appends a static executable with a single read+execute segment holding
+// the headers followed by the code, no sections and no symbols.
+void elf_write_executable(StringBuilder* bytes, const char* code, size_t code_length, size_t entry_offset)
+{
+    size_t headers_length = sizeof(Elf64_Ehdr) + sizeof(Elf64_Phdr);
+    size_t file_length = headers_length + code_length;
+
+    Elf64_Ehdr header = {
+        .e_ident = {
+            ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3,
+            ELFCLASS64, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV,
+        },
+        .e_type = ET_EXEC,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_entry = ELF_LOAD_ADDRESS + headers_length + entry_offset,
+        .e_phoff = sizeof(Elf64_Ehdr),
+        .e_shoff = 0,
+        .e_flags = 0,
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_phentsize = sizeof(Elf64_Phdr),
+        .e_phnum = 1,
+        .e_shentsize = sizeof(Elf64_Shdr),
+        .e_shnum = 0,
+        .e_shstrndx = SHN_UNDEF,
+    };
+    Elf64_Phdr program_header = {
+        .p_type = PT_LOAD,
+        .p_flags = PF_R | PF_X,
+        .p_offset = 0,
+        .p_vaddr = ELF_LOAD_ADDRESS,
+        .p_paddr = ELF_LOAD_ADDRESS,
+        .p_filesz = file_length,
+        .p_memsz = file_length,
+        .p_align = 0x1000,
+    };
+
+    string_builder_reserve(bytes, file_length);
+    string_builder_write_n(bytes, (const char*) &header, sizeof(header));
+    string_builder_write_n(bytes, (const char*) &program_header, sizeof(program_header));
+    string_builder_write_n(bytes, code, code_length);
+}
+
+void assembly_write_executable(Assembly* self, StringBuilder* bytes)
+{
+    StringBuilder* code = new_string_builder();
+    size_t* label_offsets = assembly_encode(self, code);
+    size_t entry_offset = label_offsets[assembly_label(self, "_start")];
+    elf_write_executable(bytes, string_builder_buffer(code), string_builder_length(code), entry_offset);
+    free(label_offsets);
+    delete_string_builder(code);
+}
+
+void write_executable_file(const char* path, const char* bytes, size_t length)
+{
+    FILE* fp = fopen(path, "wb");
+    assert(fp && "could not open file");
+    size_t written = fwrite(bytes, 1, length, fp);
+    assert(written == length && "could not write to file");
+    fclose(fp);
+
+    int error = chmod(path, 0755);
+    assert(error == 0 && "could not make file executable");
+}
@@ -0,0 +1,9 @@
+int end()
+{
+    return 5;
+}
+
+int main()
+{
+    return 7;
+}
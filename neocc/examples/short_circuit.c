@@ -0,0 +1,9 @@
+int main()
+{
+    int zero = 0;
+    int ten = 10;
+    int and = zero != 0 && ten / zero;
+    int or = zero == 0 || ten % zero;
+    int taken = (ten > 5 && ten / 2 == 5) + (zero > 5 || ten - 10 == 0);
+    return and + or * 2 + taken * 4 + (ten && zero) * 16 + (zero || ten) * 32;
+}
@@ -1,11 +1,16 @@
+#define _DEFAULT_SOURCE
 #include "utils.h"
 #include <assert.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 FileReader* new_file_reader(const char* path)
 {
-    FileReader* self = calloc(1, sizeof(FileReader));
+    FileReader* self = counted_calloc(1, sizeof(FileReader));
     *self = (FileReader) {
         .fp = fopen(path, "r"),
     };
@@ -29,8 +34,8 @@ char* file_reader_read(FileReader* self)
 {
     size_t length = file_reader_length(self);
     fseek(self->fp, 0, SEEK_SET);
-    char* content = calloc(length + 1, sizeof(char));
-    fread(content, length, length, self->fp);
+    char* content = counted_calloc(length + 1, sizeof(char));
+    fread(content, 1, length, self->fp);
     for (int i = 0; i < length; i++)
         if (content[i] == EOF)
             content[i] = '\0';
@@ -45,9 +50,52 @@ char* read_file(const char* path)
     return content;
 }
 
+MappedFile* new_mapped_file(const char* path)
+{
+    static_assert(sizeof(MappedFile) == 40, "incomplete construction of MappedFile");
+    int fd = open(path, O_RDONLY);
+    assert(fd >= 0 && "could not open file");
+    struct stat status;
+    int error = fstat(fd, &status);
+    assert(error == 0 && "could not stat file");
+    size_t length = status.st_size;
+
+    // The file is mapped over the start of a zeroed anonymous mapping at
+    // least one byte longer. Past the end of the file, its last page reads
+    // as zeros, and a file filling its last page is followed by the
+    // anonymous page, so the text is always terminated.
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t file_pages_length = (length + page_size - 1) & ~(page_size - 1);
+    size_t mapping_length = file_pages_length + (length == file_pages_length ? page_size : 0);
+    char* mapping = mmap(NULL, mapping_length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(mapping != MAP_FAILED && "could not reserve mapping");
+    if (length > 0) {
+        void* file_mapping = mmap(mapping, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        assert(file_mapping == mapping && "could not map file");
+    }
+    close(fd);
+
+    MappedFile* self = counted_calloc(1, sizeof(MappedFile));
+    *self = (MappedFile) {
+        .text = mapping,
+        .length = length,
+        .path = path,
+        .lines = new_line_index(mapping, length),
+        .m_mapping_length = mapping_length,
+    };
+    return self;
+}
+
+void delete_mapped_file(MappedFile* self)
+{
+    munmap((void*) self->text, self->m_mapping_length);
+    delete_line_index(self->lines);
+    free(self);
+}
+
 FileWriter* new_file_writer(const char* path)
 {
-    FileWriter* self = calloc(1, sizeof(FileWriter));
+    FileWriter* self = counted_calloc(1, sizeof(FileWriter));
     *self = (FileWriter) {
         .fp = fopen(path, "w"),
     };
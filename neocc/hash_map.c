@@ -4,61 +4,72 @@
 #include <assert.h>
 #include "utils.h"
 
+#define STRING_HASH_MAP_MIN_CAPACITY 16
 
-uint64_t hash_string(const char* value)
+static inline uint64_t rotate_left(uint64_t value, int amount)
 {
-    // https://cp-algorithms.com/string/string-hashing.html
-    // 0 <= char <= 127
-    const int p = 131;
-    const int m = 1e9 + 9;
-    size_t string_length = strlen(value);
-    long long hash_value = 0;
-    long long p_pow = 1;
-    for (int i = 0; i < string_length; i++) {
-        hash_value = (hash_value + (value[i] + 1) * p_pow) % m;
-        p_pow = (p_pow * p) % m;
-    }
-    return hash_value;
+    return (value << amount) | (value >> (64 - amount));
 }
 
-StringHashMapElement* new_string_hash_map_element(char* key, uint64_t hash, void* value)
+static inline uint64_t hash_finalize(uint64_t value)
 {
-    static_assert(sizeof(StringHashMapElement) == 24, "incomplete construction of StringHashMapElement");
-    StringHashMapElement* self = calloc(1, sizeof(StringHashMapElement));
-    *self = (StringHashMapElement) {
-        .key = key,
-        .hash = hash,
-        .value = value,
-    };
-    return self;
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
 }
 
-void delete_string_hash_map_element(StringHashMapElement* self)
+uint64_t hash_chars(const char* chars, size_t length)
 {
-    free(self->key);
-    free(self);
+    // word at a time multiply-rotate, finalized like murmur3's fmix64
+    const uint64_t k1 = 0x87c37b91114253d5ULL;
+    const uint64_t k2 = 0x4cf5ad432745937fULL;
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, chars, 8);
+        hash = rotate_left(hash ^ (word * k1), 31) * k2;
+        chars += 8;
+        length -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, chars, length);
+    hash = rotate_left(hash ^ (tail * k1), 31) * k2;
+    return hash_finalize(hash);
+}
+
+uint64_t hash_string(const char* value)
+{
+    return hash_chars(value, strlen(value));
 }
 
 StringHashMap* new_string_hash_map()
 {
-    static_assert(sizeof(Map) == 40, "incomplete implementation of Map");
-    static_assert(sizeof(StringHashMap) == 56, "incomplete construction of StringHashMap");
-    StringHashMap* self = calloc(1, sizeof(StringHashMap));
+    static_assert(sizeof(Map) == 48, "incomplete implementation of Map");
+    static_assert(sizeof(StringHashMap) == 72, "incomplete construction of StringHashMap");
+    static_assert(sizeof(StringHashMapElement) == 32, "incomplete construction of StringHashMapElement");
+    StringHashMap* self = counted_calloc(1, sizeof(StringHashMap));
     *self = (StringHashMap) {
         .delete = delete_string_hash_map,
         .length = string_hash_map_length,
         .get = string_hash_map_get,
         .set = string_hash_map_set,
         .contains_key = string_hash_map_contains_key,
+        .remove = string_hash_map_remove,
         .m_length = 0,
-        .m_elements = (List*) new_array_list(),
+        .m_capacity = STRING_HASH_MAP_MIN_CAPACITY,
+        .m_elements = counted_calloc(STRING_HASH_MAP_MIN_CAPACITY, sizeof(StringHashMapElement)),
     };
     return self;
 }
 
 void delete_string_hash_map(StringHashMap* self)
 {
-    list_delete_all_and_self(self->m_elements, (void (*)(void*)) delete_string_hash_map_element);
+    for (size_t i = 0; i < self->m_capacity; i++)
+        free(self->m_elements[i].key);
+    free(self->m_elements);
     free(self);
 }
 
@@ -67,39 +78,137 @@ size_t string_hash_map_length(StringHashMap* self)
     return self->m_length;
 }
 
-void* string_hash_map_get(StringHashMap* self, const char* string)
+static inline size_t probe_distance(StringHashMap* self, uint64_t hash, size_t index)
 {
-    // TODO binary search
-    uint64_t hash = hash_string(string);
-    for (int i = 0; i < self->m_elements->length(self->m_elements); i++) {
-        StringHashMapElement* element = self->m_elements->get(self->m_elements, i);
-        if (element->hash == hash)
-            return element->value;
-    }
-    assert(!"element with key not found");
+    return (index - (hash & (self->m_capacity - 1))) & (self->m_capacity - 1);
 }
 
-void string_hash_map_set(StringHashMap* self, const char* string, void* value)
+// Robin Hood insertion, the element is placed before any element which is
+// closer to its ideal slot, so lookups can stop early.
+static void insert_element(StringHashMap* self, StringHashMapElement element)
 {
-    uint64_t hash = hash_string(string);
-    for (int i = 0; i < self->m_elements->length(self->m_elements); i++) {
-        StringHashMapElement* element = self->m_elements->get(self->m_elements, i);
-        if (element->hash == hash) {
-            element->value = value;
-            return;
+    size_t mask = self->m_capacity - 1;
+    size_t index = element.hash & mask;
+    size_t distance = 0;
+    while (self->m_elements[index].key) {
+        size_t existing_distance = probe_distance(self, self->m_elements[index].hash, index);
+        if (existing_distance < distance) {
+            StringHashMapElement swapped = self->m_elements[index];
+            self->m_elements[index] = element;
+            element = swapped;
+            distance = existing_distance;
         }
+        index = (index + 1) & mask;
+        distance++;
+    }
+    self->m_elements[index] = element;
+}
+
+static void grow(StringHashMap* self)
+{
+    StringHashMapElement* old_elements = self->m_elements;
+    size_t old_capacity = self->m_capacity;
+    self->m_capacity *= 2;
+    self->m_elements = counted_calloc(self->m_capacity, sizeof(StringHashMapElement));
+    assert(self->m_elements && "could not allocate hash map");
+    for (size_t i = 0; i < old_capacity; i++)
+        if (old_elements[i].key)
+            insert_element(self, old_elements[i]);
+    free(old_elements);
+}
+
+static inline bool element_equals(StringHashMapElement* element, uint64_t hash, const char* key, size_t key_length)
+{
+    return element->hash == hash && element->key_length == key_length && memcmp(element->key, key, key_length) == 0;
+}
+
+static StringHashMapElement* find(StringHashMap* self, const char* key, size_t key_length, uint64_t hash)
+{
+    size_t mask = self->m_capacity - 1;
+    size_t index = hash & mask;
+    for (size_t distance = 0;; distance++, index = (index + 1) & mask) {
+        StringHashMapElement* element = &self->m_elements[index];
+        if (!element->key || probe_distance(self, element->hash, index) < distance)
+            return NULL;
+        if (element_equals(element, hash, key, key_length))
+            return element;
+    }
+}
+
+StringHashMapElement* string_hash_map_find(StringHashMap* self, const char* key, size_t key_length)
+{
+    return find(self, key, key_length, hash_chars(key, key_length));
+}
+
+void string_hash_map_set_chars(StringHashMap* self, const char* key, size_t key_length, void* value)
+{
+    uint64_t hash = hash_chars(key, key_length);
+    StringHashMapElement* existing = find(self, key, key_length, hash);
+    if (existing) {
+        existing->value = value;
+        return;
     }
-    self->m_elements->add(self->m_elements, new_string_hash_map_element(copy_string(string), hash, value));
+    // keep the load factor below 0.8
+    if ((self->m_length + 1) * 5 > self->m_capacity * 4)
+        grow(self);
+    insert_element(self, (StringHashMapElement) {
+        .key = chars_to_string(key, key_length),
+        .key_length = key_length,
+        .hash = hash,
+        .value = value,
+    });
+    self->m_length++;
+}
+
+bool string_hash_map_remove_chars(StringHashMap* self, const char* key, size_t key_length)
+{
+    StringHashMapElement* element = string_hash_map_find(self, key, key_length);
+    if (!element)
+        return false;
+    free(element->key);
+    // backward shift deletion, following elements move one slot closer to
+    // their ideal slot so no tombstone is left behind
+    size_t mask = self->m_capacity - 1;
+    size_t index = element - self->m_elements;
+    size_t next = (index + 1) & mask;
+    while (self->m_elements[next].key && probe_distance(self, self->m_elements[next].hash, next) > 0) {
+        self->m_elements[index] = self->m_elements[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+    self->m_elements[index] = (StringHashMapElement) { 0 };
+    self->m_length--;
+    return true;
+}
+
+void* string_hash_map_get(StringHashMap* self, const char* string)
+{
+    StringHashMapElement* element = string_hash_map_find(self, string, strlen(string));
+    assert(element && "element with key not found");
+    return element->value;
+}
+
+void string_hash_map_set(StringHashMap* self, const char* string, void* value)
+{
+    string_hash_map_set_chars(self, string, strlen(string), value);
 }
 
 bool string_hash_map_contains_key(StringHashMap* self, const char* string)
 {
-    // TODO binary search
-    uint64_t hash = hash_string(string);
-    for (int i = 0; i < self->m_elements->length(self->m_elements); i++) {
-        StringHashMapElement* element = self->m_elements->get(self->m_elements, i);
-        if (element->hash == hash)
-            return true;
+    return string_hash_map_find(self, string, strlen(string)) != NULL;
+}
+
+bool string_hash_map_remove(StringHashMap* self, const char* string)
+{
+    return string_hash_map_remove_chars(self, string, strlen(string));
+}
+
+StringHashMapElement* string_hash_map_iterate(StringHashMap* self, size_t* cursor)
+{
+    while (*cursor < self->m_capacity) {
+        StringHashMapElement* element = &self->m_elements[(*cursor)++];
+        if (element->key)
+            return element;
     }
-    return false;
+    return NULL;
 }
@@ -0,0 +1,727 @@
+#include "ir.h"
+#include "parser.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IR_BLOCK_MIN_CAPACITY 16
+
+const char* ir_type_to_string(IrType type)
+{
+    switch (type) {
+    case IR_TYPE_VOID:
+        return "void";
+    case IR_TYPE_I32:
+        return "i32";
+    }
+    assert(!"unreachable");
+}
+
+const char* ir_opcode_to_string(IrOpcode opcode)
+{
+    switch (opcode) {
+    case IR_OPCODE_NOP:
+        return "nop";
+    case IR_OPCODE_CONST:
+        return "const";
+    case IR_OPCODE_COPY:
+        return "copy";
+    case IR_OPCODE_ADD:
+        return "add";
+    case IR_OPCODE_SUB:
+        return "sub";
+    case IR_OPCODE_MUL:
+        return "mul";
+    case IR_OPCODE_DIV:
+        return "div";
+    case IR_OPCODE_MOD:
+        return "mod";
+    case IR_OPCODE_SHL:
+        return "shl";
+    case IR_OPCODE_SHR:
+        return "shr";
+    case IR_OPCODE_AND:
+        return "and";
+    case IR_OPCODE_OR:
+        return "or";
+    case IR_OPCODE_XOR:
+        return "xor";
+    case IR_OPCODE_EQ:
+        return "eq";
+    case IR_OPCODE_NE:
+        return "ne";
+    case IR_OPCODE_LT:
+        return "lt";
+    case IR_OPCODE_LE:
+        return "le";
+    case IR_OPCODE_GT:
+        return "gt";
+    case IR_OPCODE_GE:
+        return "ge";
+    case IR_OPCODE_PHI:
+        return "phi";
+    case IR_OPCODE_JUMP:
+        return "jump";
+    case IR_OPCODE_BRANCH:
+        return "branch";
+    case IR_OPCODE_RETURN:
+        return "return";
+    }
+    assert(!"unreachable");
+}
+
+bool ir_opcode_is_binary(IrOpcode opcode)
+{
+    switch (opcode) {
+    case IR_OPCODE_ADD:
+    case IR_OPCODE_SUB:
+    case IR_OPCODE_MUL:
+    case IR_OPCODE_DIV:
+    case IR_OPCODE_MOD:
+    case IR_OPCODE_SHL:
+    case IR_OPCODE_SHR:
+    case IR_OPCODE_AND:
+    case IR_OPCODE_OR:
+    case IR_OPCODE_XOR:
+    case IR_OPCODE_EQ:
+    case IR_OPCODE_NE:
+    case IR_OPCODE_LT:
+    case IR_OPCODE_LE:
+    case IR_OPCODE_GT:
+    case IR_OPCODE_GE:
+        return true;
+    case IR_OPCODE_NOP:
+    case IR_OPCODE_CONST:
+    case IR_OPCODE_COPY:
+    case IR_OPCODE_PHI:
+    case IR_OPCODE_JUMP:
+    case IR_OPCODE_BRANCH:
+    case IR_OPCODE_RETURN:
+        return false;
+    }
+    assert(!"unreachable");
+}
+
+IrBlock* new_ir_block(int id)
+{
+    static_assert(sizeof(IrInstruction) == 32, "incomplete construction of IrInstruction");
+    static_assert(sizeof(IrBlock) == 32, "incomplete construction of IrBlock");
+    IrBlock* self = counted_calloc(1, sizeof(IrBlock));
+    *self = (IrBlock) {
+        .id = id,
+        .removed = false,
+        .m_length = 0,
+        .m_capacity = 0,
+        .m_instructions = NULL,
+    };
+    return self;
+}
+
+void delete_ir_block(IrBlock* self)
+{
+    free(self->m_instructions);
+    free(self);
+}
+
+size_t ir_block_length(IrBlock* self)
+{
+    return self->m_length;
+}
+
+IrInstruction* ir_block_get(IrBlock* self, size_t index)
+{
+    assert(index < self->m_length && "index out of range");
+    return &self->m_instructions[index];
+}
+
+void ir_block_add(IrBlock* self, IrInstruction instruction)
+{
+    if (self->m_length == self->m_capacity) {
+        self->m_capacity = self->m_capacity ? self->m_capacity * 2 : IR_BLOCK_MIN_CAPACITY;
+        self->m_instructions = counted_realloc(self->m_instructions, sizeof(IrInstruction) * self->m_capacity);
+        assert(self->m_instructions && "could not allocate instructions");
+    }
+    self->m_instructions[self->m_length++] = instruction;
+}
+
+IrInstruction* ir_block_terminator(IrBlock* self)
+{
+    if (self->m_length == 0)
+        return NULL;
+    IrInstruction* last = &self->m_instructions[self->m_length - 1];
+    return last->opcode == IR_OPCODE_JUMP || last->opcode == IR_OPCODE_BRANCH || last->opcode == IR_OPCODE_RETURN
+        ? last
+        : NULL;
+}
+
+IrFunction* new_ir_function(const char* name, size_t name_length)
+{
+    static_assert(sizeof(IrFunction) == 64, "incomplete construction of IrFunction");
+    IrFunction* self = counted_calloc(1, sizeof(IrFunction));
+    *self = (IrFunction) {
+        .name = chars_to_string(name, name_length),
+        .blocks = (List*) new_array_list(),
+        .registers_length = 0,
+        .phi_operands_length = 0,
+        .phi_operands = NULL,
+        .source_hash = 0,
+        .cache = NULL,
+        .cached_assembly = NULL,
+    };
+    return self;
+}
+
+void delete_ir_function(IrFunction* self)
+{
+    free(self->name);
+    list_delete_all_and_self(self->blocks, (void (*)(void*)) delete_ir_block);
+    free(self->phi_operands);
+    if (self->cached_assembly)
+        delete_assembly(self->cached_assembly);
+    free(self);
+}
+
+IrBlock* ir_function_new_block(IrFunction* self)
+{
+    IrBlock* block = new_ir_block(self->blocks->length(self->blocks));
+    self->blocks->add(self->blocks, block);
+    return block;
+}
+
+IrBlock* ir_function_block(IrFunction* self, int id)
+{
+    return self->blocks->get(self->blocks, id);
+}
+
+int ir_function_new_register(IrFunction* self)
+{
+    return self->registers_length++;
+}
+
+int ir_function_add_phi_operands(IrFunction* self, const int* pairs, int pairs_length)
+{
+    int offset = self->phi_operands_length;
+    self->phi_operands_length += pairs_length * 2;
+    self->phi_operands = counted_realloc(self->phi_operands, sizeof(int) * self->phi_operands_length);
+    memcpy(self->phi_operands + offset, pairs, sizeof(int) * pairs_length * 2);
+    return offset;
+}
+
+int* ir_function_use(IrFunction* self, IrInstruction* instruction, int index)
+{
+    switch (instruction->opcode) {
+    case IR_OPCODE_COPY:
+    case IR_OPCODE_BRANCH:
+    case IR_OPCODE_RETURN:
+        return index == 0 ? &instruction->left : NULL;
+    case IR_OPCODE_ADD:
+    case IR_OPCODE_SUB:
+    case IR_OPCODE_MUL:
+    case IR_OPCODE_DIV:
+    case IR_OPCODE_MOD:
+    case IR_OPCODE_SHL:
+    case IR_OPCODE_SHR:
+    case IR_OPCODE_AND:
+    case IR_OPCODE_OR:
+    case IR_OPCODE_XOR:
+    case IR_OPCODE_EQ:
+    case IR_OPCODE_NE:
+    case IR_OPCODE_LT:
+    case IR_OPCODE_LE:
+    case IR_OPCODE_GT:
+    case IR_OPCODE_GE:
+        return index == 0 ? &instruction->left : index == 1 ? &instruction->right : NULL;
+    case IR_OPCODE_PHI:
+        return index < instruction->right ? &self->phi_operands[instruction->left + index * 2 + 1] : NULL;
+    case IR_OPCODE_NOP:
+    case IR_OPCODE_CONST:
+    case IR_OPCODE_JUMP:
+        return NULL;
+    }
+    assert(!"unreachable");
+}
+
+static void write_instruction(IrFunction* self, StringBuilder* sb, IrInstruction* instruction)
+{
+    const char* opcode = ir_opcode_to_string(instruction->opcode);
+    const char* type = ir_type_to_string(instruction->type);
+    switch (instruction->opcode) {
+    case IR_OPCODE_NOP:
+        return;
+    case IR_OPCODE_CONST:
+        string_builder_write_fmt(sb, "    %%%d = %s %s %ld\n", instruction->destination, opcode, type, instruction->value);
+        return;
+    case IR_OPCODE_COPY:
+        string_builder_write_fmt(sb, "    %%%d = %s %s %%%d\n", instruction->destination, opcode, type, instruction->left);
+        return;
+    case IR_OPCODE_ADD:
+    case IR_OPCODE_SUB:
+    case IR_OPCODE_MUL:
+    case IR_OPCODE_DIV:
+    case IR_OPCODE_MOD:
+    case IR_OPCODE_SHL:
+    case IR_OPCODE_SHR:
+    case IR_OPCODE_AND:
+    case IR_OPCODE_OR:
+    case IR_OPCODE_XOR:
+    case IR_OPCODE_EQ:
+    case IR_OPCODE_NE:
+    case IR_OPCODE_LT:
+    case IR_OPCODE_LE:
+    case IR_OPCODE_GT:
+    case IR_OPCODE_GE:
+        string_builder_write_fmt(sb, "    %%%d = %s %s %%%d, %%%d\n",
+            instruction->destination, opcode, type, instruction->left, instruction->right);
+        return;
+    case IR_OPCODE_PHI:
+        string_builder_write_fmt(sb, "    %%%d = %s %s", instruction->destination, opcode, type);
+        for (int i = 0; i < instruction->right; i++) {
+            int* pair = &self->phi_operands[instruction->left + i * 2];
+            string_builder_write_fmt(sb, "%s [b%d: %%%d]", i == 0 ? "" : ",", pair[0], pair[1]);
+        }
+        string_builder_write_char(sb, '\n');
+        return;
+    case IR_OPCODE_JUMP:
+        string_builder_write_fmt(sb, "    %s b%ld\n", opcode, instruction->value);
+        return;
+    case IR_OPCODE_BRANCH:
+        string_builder_write_fmt(
+            sb, "    %s %s %%%d, b%ld, b%d\n", opcode, type, instruction->left, instruction->value, instruction->right);
+        return;
+    case IR_OPCODE_RETURN:
+        string_builder_write_fmt(sb, "    %s %s %%%d\n", opcode, type, instruction->left);
+        return;
+    }
+}
+
+char* ir_function_to_string(IrFunction* self)
+{
+    StringBuilder* sb = new_string_builder();
+    string_builder_write_fmt(sb, "function %s\n", self->name);
+    for (int i = 0; i < self->blocks->length(self->blocks); i++) {
+        IrBlock* block = self->blocks->get(self->blocks, i);
+        if (block->removed)
+            continue;
+        string_builder_write_fmt(sb, "  b%d:\n", block->id);
+        for (size_t j = 0; j < block->m_length; j++)
+            write_instruction(self, sb, &block->m_instructions[j]);
+    }
+    char* result = string_builder_take(sb);
+    delete_string_builder(sb);
+    return result;
+}
+
+IrBuilder* new_ir_builder(Ast* ast, IrFunction* function)
+{
+    IrBuilder* self = counted_calloc(1, sizeof(IrBuilder));
+    *self = (IrBuilder) {
+        .ast = ast,
+        .function = function,
+        .block = ir_function_new_block(function),
+        .exit_block = NULL,
+        .symbols = new_string_hash_map(),
+        .returns = NULL,
+        .returns_length = 0,
+        .m_pending_length = 0,
+        .m_pending_capacity = 0,
+        .m_pending = NULL,
+        .m_values_length = 0,
+        .m_values_capacity = 0,
+        .m_values = NULL,
+    };
+    self->exit_block = ir_function_new_block(function);
+    return self;
+}
+
+void delete_ir_builder(IrBuilder* self)
+{
+    delete_string_hash_map(self->symbols);
+    free(self->returns);
+    free(self->m_pending);
+    free(self->m_values);
+    free(self);
+}
+
+static inline void add(IrBuilder* self, IrInstruction instruction)
+{
+    ir_block_add(self->block, instruction);
+}
+
+static int make_const(IrBuilder* self, int64_t value)
+{
+    int destination = ir_function_new_register(self->function);
+    add(self, (IrInstruction) {
+        .opcode = IR_OPCODE_CONST,
+        .type = IR_TYPE_I32,
+        .destination = destination,
+        .value = value,
+    });
+    return destination;
+}
+
+static int make_binary(IrBuilder* self, IrOpcode opcode, int left, int right)
+{
+    int destination = ir_function_new_register(self->function);
+    add(self, (IrInstruction) {
+        .opcode = opcode,
+        .type = IR_TYPE_I32,
+        .destination = destination,
+        .left = left,
+        .right = right,
+    });
+    return destination;
+}
+
+// 1 when value is not 0, and 0 otherwise.
+static int make_truth(IrBuilder* self, int value)
+{
+    return make_binary(self, IR_OPCODE_NE, value, make_const(self, 0));
+}
+
+void ir_builder_make_statements(IrBuilder* self, AstRef first)
+{
+    for (AstRef statement = first; statement != AST_NONE; statement = self->ast->nodes[statement].next)
+        ir_builder_make_statement(self, statement);
+}
+
+void ir_builder_make_statement(IrBuilder* self, AstRef node)
+{
+    switch (self->ast->nodes[node].kind) {
+    case AST_KIND_DECLARATION_STATEMENT:
+        return ir_builder_make_declarations(self, node);
+    case AST_KIND_RETURN:
+        return ir_builder_make_return(self, node);
+    default:
+        assert(!"unexpected statement AstKind");
+    }
+}
+
+void ir_builder_make_declarations(IrBuilder* self, AstRef node)
+{
+    AstNode* nodes = self->ast->nodes;
+    for (AstRef declaration = nodes[node].first; declaration != AST_NONE; declaration = nodes[declaration].next) {
+        int initial = nodes[declaration].kind == AST_KIND_INITIALIZATION
+            ? ir_builder_make_expression(self, nodes[declaration].second)
+            : make_const(self, 0);
+        // every variable gets its own value, copy propagation removes it
+        int value = ir_function_new_register(self->function);
+        add(self, (IrInstruction) {
+            .opcode = IR_OPCODE_COPY,
+            .type = IR_TYPE_I32,
+            .destination = value,
+            .left = initial,
+        });
+        string_hash_map_set_chars(self->symbols, self->ast->text + nodes[declaration].offset,
+            nodes[declaration].length, (void*) (intptr_t) value);
+    }
+}
+
+static void add_return(IrBuilder* self, int value)
+{
+    self->returns = counted_realloc(self->returns, sizeof(int) * 2 * (self->returns_length + 1));
+    self->returns[self->returns_length * 2] = self->block->id;
+    self->returns[self->returns_length * 2 + 1] = value;
+    self->returns_length++;
+    add(self, (IrInstruction) { .opcode = IR_OPCODE_JUMP, .value = self->exit_block->id });
+}
+
+void ir_builder_make_return(IrBuilder* self, AstRef node)
+{
+    add_return(self, ir_builder_make_expression(self, self->ast->nodes[node].first));
+    // anything after a return is unreachable, and is removed again later
+    self->block = ir_function_new_block(self->function);
+}
+
+void ir_builder_finish(IrBuilder* self)
+{
+    // falling off the end returns 0
+    add_return(self, make_const(self, 0));
+    self->block = self->exit_block;
+    int value = ir_function_new_register(self->function);
+    add(self, (IrInstruction) {
+        .opcode = IR_OPCODE_PHI,
+        .type = IR_TYPE_I32,
+        .destination = value,
+        .left = ir_function_add_phi_operands(self->function, self->returns, self->returns_length),
+        .right = self->returns_length,
+    });
+    add(self, (IrInstruction) { .opcode = IR_OPCODE_RETURN, .type = IR_TYPE_I32, .left = value });
+}
+
+static inline void push_pending(IrBuilder* self, AstRef node, IrPendingStep step)
+{
+    if (self->m_pending_length == self->m_pending_capacity) {
+        self->m_pending_capacity = self->m_pending_capacity ? self->m_pending_capacity * 2 : 16;
+        self->m_pending = counted_realloc(self->m_pending, sizeof(IrPendingExpression) * self->m_pending_capacity);
+    }
+    self->m_pending[self->m_pending_length++] = (IrPendingExpression) { .node = node, .step = step };
+}
+
+static inline void push_value(IrBuilder* self, int value)
+{
+    if (self->m_values_length == self->m_values_capacity) {
+        self->m_values_capacity = self->m_values_capacity ? self->m_values_capacity * 2 : 16;
+        self->m_values = counted_realloc(self->m_values, sizeof(int) * self->m_values_capacity);
+    }
+    self->m_values[self->m_values_length++] = value;
+}
+
+static inline bool is_leaf(AstNode* node)
+{
+    return node->kind == AST_KIND_SYMBOL || node->kind == AST_KIND_INT;
+}
+
+static inline int ir_builder_make_leaf(IrBuilder* self, AstRef node)
+{
+    return self->ast->nodes[node].kind == AST_KIND_SYMBOL ? ir_builder_make_symbol(self, node)
+                                                          : ir_builder_make_int_literal(self, node);
+}
+
+static inline bool is_short_circuit(BinaryOperationType type)
+{
+    return type == BINARY_OPERATION_TYPE_LOGICAL_AND || type == BINARY_OPERATION_TYPE_LOGICAL_OR;
+}
+
+// Ends the current block with a branch on the truth of left, into a new
+// block for the right operand or, where that decides the result, to the
+// join block, which only exists once the right operand is lowered. Pushes
+// the truth and the branching block for make_short_circuit_join.
+static void make_short_circuit_branch(IrBuilder* self, BinaryOperationType type, int left)
+{
+    int left_truth = make_truth(self, left);
+    IrBlock* right_block = ir_function_new_block(self->function);
+    bool is_and = type == BINARY_OPERATION_TYPE_LOGICAL_AND;
+    add(self, (IrInstruction) {
+        .opcode = IR_OPCODE_BRANCH,
+        .type = IR_TYPE_I32,
+        .left = left_truth,
+        .right = is_and ? -1 : right_block->id,
+        .value = is_and ? right_block->id : -1,
+    });
+    push_value(self, left_truth);
+    push_value(self, self->block->id);
+    self->block = right_block;
+}
+
+// The result is the truth of left when the branch skipped the right
+// operand, which is 0 for && and 1 for ||, and the truth of right otherwise.
+static int make_short_circuit_join(IrBuilder* self, BinaryOperationType type, int right)
+{
+    int right_truth = make_truth(self, right);
+    int branch_block = self->m_values[--self->m_values_length];
+    int left_truth = self->m_values[--self->m_values_length];
+    IrBlock* join = ir_function_new_block(self->function);
+    IrInstruction* branch = ir_block_terminator(ir_function_block(self->function, branch_block));
+    if (type == BINARY_OPERATION_TYPE_LOGICAL_AND)
+        branch->right = join->id;
+    else
+        branch->value = join->id;
+    add(self, (IrInstruction) { .opcode = IR_OPCODE_JUMP, .value = join->id });
+    int pairs[] = { branch_block, left_truth, self->block->id, right_truth };
+    self->block = join;
+    int value = ir_function_new_register(self->function);
+    add(self, (IrInstruction) {
+        .opcode = IR_OPCODE_PHI,
+        .type = IR_TYPE_I32,
+        .destination = value,
+        .left = ir_function_add_phi_operands(self->function, pairs, 2),
+        .right = 2,
+    });
+    return value;
+}
+
+// Post-order walk with an explicit stack, a binary operation is pushed
+// again below its operands and combines their values when it comes back
+// up. && and || are also pushed between their operands, to branch around
+// the right one.
+int ir_builder_make_expression(IrBuilder* self, AstRef node)
+{
+    AstNode* nodes = self->ast->nodes;
+    size_t pending_base = self->m_pending_length;
+    push_pending(self, node, IR_PENDING_STEP_START);
+    while (self->m_pending_length > pending_base) {
+        IrPendingExpression pending = self->m_pending[--self->m_pending_length];
+        AstNode* operation = &nodes[pending.node];
+        switch (operation->kind) {
+        case AST_KIND_BINARY_OPERATION: {
+            if (pending.step == IR_PENDING_STEP_START && is_leaf(&nodes[operation->first])
+                && is_leaf(&nodes[operation->second])) {
+                // the common shallow case skips the stacks, and leaves
+                // can't trap, so && and || may evaluate both
+                int left = ir_builder_make_leaf(self, operation->first);
+                int right = ir_builder_make_leaf(self, operation->second);
+                push_value(self, ir_builder_make_binary_operation(self, operation->operation_type, left, right));
+                break;
+            }
+            if (pending.step == IR_PENDING_STEP_START) {
+                push_pending(self, pending.node, IR_PENDING_STEP_COMBINE);
+                push_pending(self, operation->second, IR_PENDING_STEP_START);
+                if (is_short_circuit(operation->operation_type))
+                    push_pending(self, pending.node, IR_PENDING_STEP_SHORT_CIRCUIT);
+                push_pending(self, operation->first, IR_PENDING_STEP_START);
+                break;
+            }
+            if (pending.step == IR_PENDING_STEP_SHORT_CIRCUIT) {
+                make_short_circuit_branch(self, operation->operation_type, self->m_values[--self->m_values_length]);
+                break;
+            }
+            int right = self->m_values[--self->m_values_length];
+            if (is_short_circuit(operation->operation_type)) {
+                push_value(self, make_short_circuit_join(self, operation->operation_type, right));
+                break;
+            }
+            int left = self->m_values[--self->m_values_length];
+            push_value(self, ir_builder_make_binary_operation(self, operation->operation_type, left, right));
+            break;
+        }
+        case AST_KIND_SYMBOL:
+        case AST_KIND_INT:
+            push_value(self, ir_builder_make_leaf(self, pending.node));
+            break;
+        default:
+            assert(!"unexpected expression AstKind");
+        }
+    }
+    return self->m_values[--self->m_values_length];
+}
+
+int ir_builder_make_binary_operation(IrBuilder* self, BinaryOperationType type, int left, int right)
+{
+    switch (type) {
+    case BINARY_OPERATION_TYPE_MULTIPLY:
+        return make_binary(self, IR_OPCODE_MUL, left, right);
+    case BINARY_OPERATION_TYPE_DIVIDE:
+        return make_binary(self, IR_OPCODE_DIV, left, right);
+    case BINARY_OPERATION_TYPE_MODULO:
+        return make_binary(self, IR_OPCODE_MOD, left, right);
+    case BINARY_OPERATION_TYPE_ADD:
+        return make_binary(self, IR_OPCODE_ADD, left, right);
+    case BINARY_OPERATION_TYPE_SUBTRACT:
+        return make_binary(self, IR_OPCODE_SUB, left, right);
+    case BINARY_OPERATION_TYPE_LEFT_SHIFT:
+        return make_binary(self, IR_OPCODE_SHL, left, right);
+    case BINARY_OPERATION_TYPE_RIGHT_SHIFT:
+        return make_binary(self, IR_OPCODE_SHR, left, right);
+    case BINARY_OPERATION_TYPE_LESS:
+        return make_binary(self, IR_OPCODE_LT, left, right);
+    case BINARY_OPERATION_TYPE_LESS_EQUAL:
+        return make_binary(self, IR_OPCODE_LE, left, right);
+    case BINARY_OPERATION_TYPE_GREATER:
+        return make_binary(self, IR_OPCODE_GT, left, right);
+    case BINARY_OPERATION_TYPE_GREATER_EQUAL:
+        return make_binary(self, IR_OPCODE_GE, left, right);
+    case BINARY_OPERATION_TYPE_EQUAL:
+        return make_binary(self, IR_OPCODE_EQ, left, right);
+    case BINARY_OPERATION_TYPE_NOT_EQUAL:
+        return make_binary(self, IR_OPCODE_NE, left, right);
+    case BINARY_OPERATION_TYPE_BITWISE_AND:
+        return make_binary(self, IR_OPCODE_AND, left, right);
+    case BINARY_OPERATION_TYPE_BITWISE_XOR:
+        return make_binary(self, IR_OPCODE_XOR, left, right);
+    case BINARY_OPERATION_TYPE_BITWISE_OR:
+        return make_binary(self, IR_OPCODE_OR, left, right);
+    case BINARY_OPERATION_TYPE_LOGICAL_AND:
+    case BINARY_OPERATION_TYPE_LOGICAL_OR:
+        // both operands are already evaluated here, ir_builder_make_expression
+        // branches around right operands that could trap
+        return make_binary(self, type == BINARY_OPERATION_TYPE_LOGICAL_AND ? IR_OPCODE_AND : IR_OPCODE_OR,
+            make_truth(self, left), make_truth(self, right));
+    }
+    assert(!"unreachable");
+}
+
+int ir_builder_make_symbol(IrBuilder* self, AstRef node)
+{
+    AstNode* symbol_node = &self->ast->nodes[node];
+    StringHashMapElement* symbol
+        = string_hash_map_find(self->symbols, self->ast->text + symbol_node->offset, symbol_node->length);
+    assert(symbol && "undefined symbol");
+    return (int) (intptr_t) symbol->value;
+}
+
+int ir_builder_make_int_literal(IrBuilder* self, AstRef node)
+{
+    AstNode* int_node = &self->ast->nodes[node];
+    char* value_string = chars_to_string(self->ast->text + int_node->offset, int_node->length);
+    int value = atoi(value_string);
+    free(value_string);
+    return make_const(self, value);
+}
+
+static IrFunction* new_ir_function_for(Ast* ast, AstRef definition)
+{
+    AstNode* declaration = &ast->nodes[ast->nodes[definition].first];
+    // the entry point compile adds, which calls main
+    assert((declaration->length != 6 || memcmp(ast->text + declaration->offset, "_start", 6) != 0)
+        && "function _start is reserved");
+    return new_ir_function(ast->text + declaration->offset, declaration->length);
+}
+
+IrFunction* lower_function(Ast* ast, AstRef definition)
+{
+    IrFunction* function = new_ir_function_for(ast, definition);
+    IrBuilder* builder = new_ir_builder(ast, function);
+    ir_builder_make_statements(builder, ast->nodes[definition].second);
+    ir_builder_finish(builder);
+    delete_ir_builder(builder);
+    return function;
+}
+
+typedef struct LowerJob {
+    Ast* ast;
+    // the top level statements in order
+    AstRef* definitions;
+    IrFunction** functions;
+    FunctionCache* cache;
+} LowerJob;
+
+static void lower_job(void* context, size_t index)
+{
+    LowerJob* job = context;
+    AstRef definition = job->definitions[index];
+    AstNode* node = &job->ast->nodes[definition];
+    assert(node->kind == AST_KIND_FUNC_DEF && "unexpected top level statement");
+    if (!job->cache) {
+        job->functions[index] = lower_function(job->ast, definition);
+        return;
+    }
+    uint64_t key = hash_chars(job->ast->text + node->offset, node->length) ^ FUNCTION_CACHE_VERSION;
+    Assembly* cached = function_cache_load(job->cache, key);
+    IrFunction* function
+        = cached ? new_ir_function_for(job->ast, definition) : lower_function(job->ast, definition);
+    function->source_hash = key;
+    function->cache = job->cache;
+    function->cached_assembly = cached;
+    job->functions[index] = function;
+}
+
+List* lower(Ast* ast, int jobs)
+{
+    return lower_cached(ast, jobs, NULL);
+}
+
+List* lower_cached(Ast* ast, int jobs, FunctionCache* cache)
+{
+    size_t length = 0;
+    for (AstRef statement = ast->statements; statement != AST_NONE; statement = ast->nodes[statement].next)
+        length++;
+    LowerJob job = {
+        .ast = ast,
+        .definitions = counted_calloc(length, sizeof(AstRef)),
+        .functions = counted_calloc(length, sizeof(IrFunction*)),
+        .cache = cache,
+    };
+    size_t index = 0;
+    for (AstRef statement = ast->statements; statement != AST_NONE; statement = ast->nodes[statement].next)
+        job.definitions[index++] = statement;
+    parallel_for(length, jobs, lower_job, &job);
+    ArrayList* functions = new_array_list();
+    array_list_reserve(functions, length);
+    for (size_t i = 0; i < length; i++)
+        array_list_add(functions, job.functions[i]);
+    free(job.definitions);
+    free(job.functions);
+    return (List*) functions;
+}
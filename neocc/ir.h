@@ -0,0 +1,189 @@
+#pragma once
+
+#include "assembly.h"
+#include "parser.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum IrType {
+    IR_TYPE_VOID,
+    IR_TYPE_I32,
+} IrType;
+
+const char* ir_type_to_string(IrType type);
+
+typedef enum IrOpcode {
+    // removed by a pass, skipped by everything
+    IR_OPCODE_NOP,
+    // destination = value
+    IR_OPCODE_CONST,
+    // destination = left
+    IR_OPCODE_COPY,
+    // destination = left <operator> right, on i32 with the semantics of C,
+    // comparisons are 0 or 1
+    IR_OPCODE_ADD,
+    IR_OPCODE_SUB,
+    IR_OPCODE_MUL,
+    IR_OPCODE_DIV,
+    IR_OPCODE_MOD,
+    IR_OPCODE_SHL,
+    IR_OPCODE_SHR,
+    IR_OPCODE_AND,
+    IR_OPCODE_OR,
+    IR_OPCODE_XOR,
+    IR_OPCODE_EQ,
+    IR_OPCODE_NE,
+    IR_OPCODE_LT,
+    IR_OPCODE_LE,
+    IR_OPCODE_GT,
+    IR_OPCODE_GE,
+    // destination = one of the incoming values, depending on the block
+    // control came from. left and right are the offset and length of the
+    // (block, value) pairs in the function's phi operands.
+    IR_OPCODE_PHI,
+    // terminator, continue in block value
+    IR_OPCODE_JUMP,
+    // terminator, continue in block value when left is not 0 and in block
+    // right otherwise
+    IR_OPCODE_BRANCH,
+    // terminator, return left
+    IR_OPCODE_RETURN,
+} IrOpcode;
+
+const char* ir_opcode_to_string(IrOpcode opcode);
+bool ir_opcode_is_binary(IrOpcode opcode);
+
+// Operands are virtual registers. In SSA form every virtual register is
+// assigned by exactly one instruction.
+typedef struct IrInstruction {
+    IrOpcode opcode;
+    IrType type;
+    int destination;
+    int left;
+    int right;
+    int64_t value;
+} IrInstruction;
+
+// A basic block ends with exactly one terminator, and only its last
+// instruction is a terminator.
+typedef struct IrBlock {
+    int id;
+    bool removed;
+    size_t m_length;
+    size_t m_capacity;
+    IrInstruction* m_instructions;
+} IrBlock;
+
+IrBlock* new_ir_block(int id);
+void delete_ir_block(IrBlock* self);
+size_t ir_block_length(IrBlock* self);
+IrInstruction* ir_block_get(IrBlock* self, size_t index);
+void ir_block_add(IrBlock* self, IrInstruction instruction);
+IrInstruction* ir_block_terminator(IrBlock* self);
+
+typedef struct IrFunction {
+    char* name;
+    List* blocks;
+    int registers_length;
+    size_t phi_operands_length;
+    int* phi_operands;
+    // hash of the definition's source text, the key in cache
+    uint64_t source_hash;
+    // where the assembly of the function is stored after compiling, or NULL
+    FunctionCache* cache;
+    // found in cache, the function has no blocks and skips compiling
+    Assembly* cached_assembly;
+} IrFunction;
+
+IrFunction* new_ir_function(const char* name, size_t name_length);
+void delete_ir_function(IrFunction* self);
+IrBlock* ir_function_new_block(IrFunction* self);
+IrBlock* ir_function_block(IrFunction* self, int id);
+int ir_function_new_register(IrFunction* self);
+int ir_function_add_phi_operands(IrFunction* self, const int* pairs, int pairs_length);
+// Returns the index'th virtual register used by instruction, or NULL when
+// it uses fewer.
+int* ir_function_use(IrFunction* self, IrInstruction* instruction, int index);
+char* ir_function_to_string(IrFunction* self);
+
+typedef enum IrPendingStep {
+    // nothing of the expression has been lowered
+    IR_PENDING_STEP_START,
+    // the left operand of && or || has been lowered, and decides whether
+    // the right one is
+    IR_PENDING_STEP_SHORT_CIRCUIT,
+    // the operands have been lowered
+    IR_PENDING_STEP_COMBINE,
+} IrPendingStep;
+
+typedef struct IrPendingExpression {
+    AstRef node;
+    IrPendingStep step;
+} IrPendingExpression;
+
+typedef struct IrBuilder {
+    Ast* ast;
+    IrFunction* function;
+    IrBlock* block;
+    IrBlock* exit_block;
+    StringHashMap* symbols;
+    // (block, value) pairs of every return, merged by a phi in the exit block
+    int* returns;
+    int returns_length;
+    // work and value stacks of ir_builder_make_expression, which lowers
+    // without recursing
+    size_t m_pending_length;
+    size_t m_pending_capacity;
+    IrPendingExpression* m_pending;
+    size_t m_values_length;
+    size_t m_values_capacity;
+    int* m_values;
+} IrBuilder;
+
+IrBuilder* new_ir_builder(Ast* ast, IrFunction* function);
+void delete_ir_builder(IrBuilder* self);
+// Lowers the statement first and every one following it.
+void ir_builder_make_statements(IrBuilder* self, AstRef first);
+void ir_builder_make_statement(IrBuilder* self, AstRef node);
+void ir_builder_make_declarations(IrBuilder* self, AstRef node);
+void ir_builder_make_return(IrBuilder* self, AstRef node);
+void ir_builder_finish(IrBuilder* self);
+int ir_builder_make_expression(IrBuilder* self, AstRef node);
+int ir_builder_make_binary_operation(IrBuilder* self, BinaryOperationType type, int left, int right);
+int ir_builder_make_symbol(IrBuilder* self, AstRef node);
+int ir_builder_make_int_literal(IrBuilder* self, AstRef node);
+
+IrFunction* lower_function(Ast* ast, AstRef definition);
+// Lowers every function definition of the ast into a list of IrFunction,
+// using up to jobs threads.
+List* lower(Ast* ast, int jobs);
+// Like lower, but functions whose source text has an entry in cache take
+// their assembly from there instead of being lowered, and the others are
+// stored in cache when compiled.
+List* lower_cached(Ast* ast, int jobs, FunctionCache* cache);
+
+// Parses, lowers and optimizes every file on up to jobs threads and returns
+// the functions of all of them in input order. Function names are global,
+// a name defined in two files is an error, and one of them defines main.
+// Either cache may be NULL.
+List* lower_files(const char** paths, size_t paths_length, int jobs, FunctionCache* cache, AstCache* ast_cache);
+
+void optimize_function(IrFunction* function);
+void optimize(List* functions, int jobs);
+
+// Replaces every phi with copies at the end of its predecessors. Virtual
+// registers may be assigned more than once afterwards.
+void lower_phis(IrFunction* function);
+
+// Location of every virtual register, either a physical register or a
+// %rbp relative stack slot. Constants aren't allocated, their location is
+// the immediate value.
+typedef struct RegisterAllocation {
+    Operand* locations;
+    int locations_length;
+    int spill_slots;
+} RegisterAllocation;
+
+RegisterAllocation* allocate_registers(IrFunction* function, const Register* available, int available_length);
+void delete_register_allocation(RegisterAllocation* self);
@@ -0,0 +1,58 @@
+#define _DEFAULT_SOURCE
+#include "assembly.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+JitCode* new_jit_code(Assembly* assembly)
+{
+    static_assert(sizeof(JitCode) == 32, "incomplete construction of JitCode");
+    StringBuilder* code = new_string_builder();
+    size_t* label_offsets = assembly_encode(assembly, code);
+    size_t length = string_builder_length(code);
+
+    // written while only writable, then only executable
+    char* memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(memory != MAP_FAILED && "could not map memory for code");
+    memcpy(memory, string_builder_buffer(code), length);
+    int error = mprotect(memory, length, PROT_READ | PROT_EXEC);
+    assert(error == 0 && "could not make code executable");
+    delete_string_builder(code);
+
+    JitCode* self = counted_calloc(1, sizeof(JitCode));
+    *self = (JitCode) {
+        .m_memory = memory,
+        .m_length = length,
+        .m_labels_length = assembly_labels_length(assembly),
+        .m_label_offsets = label_offsets,
+    };
+    return self;
+}
+
+void delete_jit_code(JitCode* self)
+{
+    munmap(self->m_memory, self->m_length);
+    free(self->m_label_offsets);
+    free(self);
+}
+
+size_t jit_code_length(JitCode* self)
+{
+    return self->m_length;
+}
+
+void* jit_code_address(JitCode* self, int label)
+{
+    assert(label >= 0 && (size_t) label < self->m_labels_length && "label out of range");
+    return self->m_memory + self->m_label_offsets[label];
+}
+
+int jit_run(Assembly* assembly)
+{
+    JitCode* code = new_jit_code(assembly);
+    JitFunction main_function = (JitFunction) jit_code_address(code, assembly_label(assembly, "main"));
+    int result = main_function();
+    delete_jit_code(code);
+    return result;
+}
@@ -5,11 +5,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-List* tokenize(char* text)
+TokenBuffer* tokenize(const char* text, size_t length)
 {
-    Lexer* lexer = new_lexer(text);
-    List* result = lexer_tokenize(lexer);
+    Lexer* lexer = new_lexer(text, length);
+    TokenBuffer* result = lexer_tokenize(lexer);
     delete_lexer(lexer);
     return result;
 }
@@ -61,8 +64,42 @@ const char* token_type_to_string(TokenType type)
         return "TOKEN_TYPE_ASSIGN";
     case TOKEN_TYPE_EQUAL:
         return "TOKEN_TYPE_EQUAL";
+    case TOKEN_TYPE_NOT_EQUAL:
+        return "TOKEN_TYPE_NOT_EQUAL";
+    case TOKEN_TYPE_NOT:
+        return "TOKEN_TYPE_NOT";
     case TOKEN_TYPE_PLUS:
         return "TOKEN_TYPE_PLUS";
+    case TOKEN_TYPE_MINUS:
+        return "TOKEN_TYPE_MINUS";
+    case TOKEN_TYPE_STAR:
+        return "TOKEN_TYPE_STAR";
+    case TOKEN_TYPE_SLASH:
+        return "TOKEN_TYPE_SLASH";
+    case TOKEN_TYPE_PERCENT:
+        return "TOKEN_TYPE_PERCENT";
+    case TOKEN_TYPE_LEFT_SHIFT:
+        return "TOKEN_TYPE_LEFT_SHIFT";
+    case TOKEN_TYPE_RIGHT_SHIFT:
+        return "TOKEN_TYPE_RIGHT_SHIFT";
+    case TOKEN_TYPE_LESS:
+        return "TOKEN_TYPE_LESS";
+    case TOKEN_TYPE_LESS_EQUAL:
+        return "TOKEN_TYPE_LESS_EQUAL";
+    case TOKEN_TYPE_GREATER:
+        return "TOKEN_TYPE_GREATER";
+    case TOKEN_TYPE_GREATER_EQUAL:
+        return "TOKEN_TYPE_GREATER_EQUAL";
+    case TOKEN_TYPE_AMPERSAND:
+        return "TOKEN_TYPE_AMPERSAND";
+    case TOKEN_TYPE_CARET:
+        return "TOKEN_TYPE_CARET";
+    case TOKEN_TYPE_PIPE:
+        return "TOKEN_TYPE_PIPE";
+    case TOKEN_TYPE_AND:
+        return "TOKEN_TYPE_AND";
+    case TOKEN_TYPE_OR:
+        return "TOKEN_TYPE_OR";
     case TOKEN_TYPE_EOL:
         return "TOKEN_TYPE_EOL";
     case TOKEN_TYPE_EOF:
@@ -71,47 +108,91 @@ const char* token_type_to_string(TokenType type)
     assert(0 && "unreachable");
 }
 
-Token* new_token(
-    const TokenType type,
-    const char* value,
-    const size_t length)
+char* token_to_string(Token* self)
 {
-    Token* self = calloc(1, sizeof(Token));
-    *self = (Token) {
-        .type = type,
-        .value = value,
-        .length = length,
+    char* value_str = chars_to_string(self->value, self->length);
+
+    char* buffer = counted_calloc(8192, sizeof(char));
+    snprintf(buffer, 8192, "Token(%s, '%s', %ld)", token_type_to_string(self->type), value_str, self->length);
+    buffer = counted_realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+
+    free(value_str);
+
+    return buffer;
+}
+
+TokenBuffer* new_token_buffer(const char* text)
+{
+    static_assert(sizeof(TokenBuffer) == 48, "incomplete construction of TokenBuffer");
+    TokenBuffer* self = counted_calloc(1, sizeof(TokenBuffer));
+    *self = (TokenBuffer) {
+        .text = text,
+        .m_length = 0,
+        .m_capacity = 0,
+        .types = NULL,
+        .offsets = NULL,
+        .lengths = NULL,
     };
     return self;
 }
 
-void delete_token(Token* self)
+void delete_token_buffer(TokenBuffer* self)
 {
+    free(self->types);
+    free(self->offsets);
+    free(self->lengths);
     free(self);
 }
 
-char* token_to_string(Token* self)
+size_t token_buffer_length(TokenBuffer* self)
 {
-    char* value_str = chars_to_string(self->value, self->length);
+    return self->m_length;
+}
 
-    char* buffer = calloc(8192, sizeof(char));
-    snprintf(buffer, 8192, "Token(%s, '%s', %ld)", token_type_to_string(self->type), value_str, self->length);
-    buffer = realloc(buffer, strlen(buffer) * sizeof(char) + 1);
+void token_buffer_reserve(TokenBuffer* self, size_t capacity)
+{
+    if (capacity <= self->m_capacity)
+        return;
+    self->m_capacity = capacity;
+    self->types = counted_realloc(self->types, sizeof(uint8_t) * capacity);
+    self->offsets = counted_realloc(self->offsets, sizeof(uint32_t) * capacity);
+    self->lengths = counted_realloc(self->lengths, sizeof(uint32_t) * capacity);
+    assert(self->types && self->offsets && self->lengths && "could not allocate tokens");
+}
 
-    free(value_str);
+void token_buffer_add(TokenBuffer* self, TokenType type, uint32_t offset, uint32_t length)
+{
+    if (self->m_length == self->m_capacity)
+        token_buffer_reserve(self, self->m_capacity ? self->m_capacity * 2 : 64);
+    self->types[self->m_length] = type;
+    self->offsets[self->m_length] = offset;
+    self->lengths[self->m_length] = length;
+    self->m_length++;
+}
 
-    return buffer;
+Token token_buffer_get(TokenBuffer* self, size_t index)
+{
+    assert(index < self->m_length && "index out of range");
+    return (Token) {
+        .type = self->types[index],
+        .value = self->text + self->offsets[index],
+        .length = self->lengths[index],
+    };
 }
 
-Lexer* new_lexer(char* text)
+Lexer* new_lexer(const char* text, size_t length)
 {
-    static_assert(sizeof(Lexer) == 16, "incomplete construction of Lexer");
-    Lexer* self = calloc(1, sizeof(Lexer));
+    static_assert(sizeof(Lexer) == 48, "incomplete construction of Lexer");
+    assert(length <= UINT32_MAX && "token offsets are 32 bit");
+    Lexer* self = counted_calloc(1, sizeof(Lexer));
     *self = (Lexer) {
+        .token = (Token) { .type = TOKEN_TYPE_EOF, .value = text, .length = 0 },
         .text = text,
+        .length = length,
         .index = 0,
         .c = text[0],
-        .done = false,
+        .done = text[0] == '\0',
+        .scalar = false,
     };
     return self;
 }
@@ -125,38 +206,123 @@ static inline bool is_whitespace(const char c) { return c == ' ' || c == '\t' ||
 static inline bool is_digit(const char c) { return c >= '0' && c <= '9'; }
 static inline bool is_letter(const char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_'; }
 
-List* lexer_tokenize(Lexer* self)
+typedef enum CharClass {
+    CHAR_CLASS_WHITESPACE,
+    CHAR_CLASS_DIGIT,
+    CHAR_CLASS_NAME,
+} CharClass;
+
+static inline bool is_in_class(const char c, CharClass class)
 {
-    List* tokens = (List*) new_array_list();
+    switch (class) {
+    case CHAR_CLASS_WHITESPACE:
+        return is_whitespace(c);
+    case CHAR_CLASS_DIGIT:
+        return is_digit(c);
+    case CHAR_CLASS_NAME:
+        return is_letter(c) || is_digit(c);
+    }
+    assert(!"unreachable");
+}
 
-    while (!self->done) {
-        if (is_whitespace(self->c)) {
-            lexer_next(self);
-        } else if (is_digit(self->c)) {
-            tokens->add(tokens, lexer_make_number(self));
-        } else if (is_letter(self->c)) {
-            tokens->add(tokens, lexer_make_name(self));
-        } else {
-            tokens->add(tokens, lexer_match_char(self));
+#ifdef __SSE2__
+// Bytes outside of ASCII compare as negative, so they are in no range.
+static inline __m128i bytes_in_range(__m128i bytes, char low, char high)
+{
+    return _mm_and_si128(
+        _mm_cmpgt_epi8(bytes, _mm_set1_epi8(low - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(high + 1)));
+}
+
+static inline int class_mask(__m128i bytes, CharClass class)
+{
+    __m128i in_class;
+    switch (class) {
+    case CHAR_CLASS_WHITESPACE:
+        in_class = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+        break;
+    case CHAR_CLASS_DIGIT:
+        in_class = bytes_in_range(bytes, '0', '9');
+        break;
+    case CHAR_CLASS_NAME:
+        // setting 0x20 maps upper case letters onto lower case
+        in_class = _mm_or_si128(
+            _mm_or_si128(bytes_in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z'),
+                bytes_in_range(bytes, '0', '9')),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+        break;
+    }
+    return _mm_movemask_epi8(in_class);
+}
+#endif
+
+// Advances past the run of chars in class, 16 at a time while they fit
+// before the end of the text, and then one at a time.
+static inline void lexer_skip_run(Lexer* self, CharClass class)
+{
+#ifdef __SSE2__
+    if (!self->scalar) {
+        while ((size_t) self->index + 16 <= self->length) {
+            int mask = class_mask(_mm_loadu_si128((const __m128i*) &self->text[self->index]), class);
+            if (mask != 0xFFFF) {
+                self->index += __builtin_ctz(~mask);
+                break;
+            }
+            self->index += 16;
         }
+        self->c = self->text[self->index];
+        self->done = self->c == '\0';
     }
+#endif
+    while (!self->done && is_in_class(self->c, class))
+        lexer_next(self);
+}
 
-    tokens->add(tokens, new_token(TOKEN_TYPE_EOF, self->text + self->index, 1));
+static inline void lexer_add(Lexer* self, TokenType type, uint32_t start)
+{
+    self->token = (Token) {
+        .type = type,
+        .value = &self->text[start],
+        .length = self->index - start,
+    };
+}
+
+TokenBuffer* lexer_tokenize(Lexer* self)
+{
+    TokenBuffer* tokens = new_token_buffer(self->text);
+    // source averages a bit more than 4 chars per token
+    token_buffer_reserve(tokens, self->length / 4 + 1);
+    do {
+        lexer_next_token(self);
+        token_buffer_add(tokens, self->token.type, self->token.value - self->text, self->token.length);
+    } while (self->token.type != TOKEN_TYPE_EOF);
     return tokens;
 }
 
-static inline Token* call_next_after(Lexer* self, Token* token)
+void lexer_next_token(Lexer* self)
 {
-    lexer_next(self);
-    return token;
+    if (is_whitespace(self->c))
+        lexer_skip_run(self, CHAR_CLASS_WHITESPACE);
+    if (self->done) {
+        self->token = (Token) { .type = TOKEN_TYPE_EOF, .value = &self->text[self->index], .length = 1 };
+    } else if (is_digit(self->c)) {
+        lexer_make_number(self);
+    } else if (is_letter(self->c)) {
+        lexer_make_name(self);
+    } else {
+        lexer_match_char(self);
+    }
 }
 
-static inline Token* make_single_char_token_and_call_next_after(Lexer* self, TokenType type)
+static inline void make_single_char_token_and_call_next_after(Lexer* self, TokenType type)
 {
-    return call_next_after(self, new_token(type, &self->text[self->index], 1));
+    uint32_t start = self->index;
+    lexer_next(self);
+    lexer_add(self, type, start);
 }
 
-Token* lexer_match_char(Lexer* self)
+void lexer_match_char(Lexer* self)
 {
     switch (self->c) {
     case '(':
@@ -173,72 +339,137 @@ Token* lexer_match_char(Lexer* self)
         return make_single_char_token_and_call_next_after(self, TOKEN_TYPE_RBRACKET);
     case '=':
         return lexer_make_equal_or_assign(self);
+    case '!':
     case '+':
-        return make_single_char_token_and_call_next_after(self, TOKEN_TYPE_PLUS);
+    case '-':
+    case '*':
+    case '/':
+    case '%':
+    case '<':
+    case '>':
+    case '&':
+    case '^':
+    case '|':
+        return lexer_make_operator(self);
     case ';':
         return make_single_char_token_and_call_next_after(self, TOKEN_TYPE_EOL);
     default:
-        printf("unexpected char %d == '%c'\n", self->c, self->c);
+        fprintf(stderr, "error: unexpected char %d == '%c'\n", self->c, self->c);
         assert(!"unexpected char");
     }
 }
 
-Token* lexer_make_number(Lexer* self)
+void lexer_make_number(Lexer* self)
 {
-    const char* value = &self->text[self->index];
-    size_t value_length = 1;
-    lexer_next(self);
-    while (!self->done && is_digit(self->c)) {
-        value_length++;
-        lexer_next(self);
-    }
-    return new_token(TOKEN_TYPE_INT_LITERAL, value, value_length);
+    uint32_t start = self->index;
+    lexer_skip_run(self, CHAR_CLASS_DIGIT);
+    lexer_add(self, TOKEN_TYPE_INT_LITERAL, start);
 }
 
-#define CHECK_KEYWORD(identifier, type, keyword) \
-    ({                                                   \
-        if (strncmp(identifer, keyword, strlen(keyword)) == 0)    \
-            return type;                                 \
-    })
+// Every keyword has a distinct (length, first char) pair, so one switch
+// probe and one comparison of the whole token decide.
+#define KEYWORD_KEY(length, first) ((length) << 8 | (first))
+#define KEYWORD_CASE(first, keyword, type)                                  \
+    case KEYWORD_KEY(sizeof(keyword) - 1, first):                           \
+        return memcmp(value, keyword, length) == 0 ? type : TOKEN_TYPE_IDENTIFIER;
 
-static inline TokenType identifier_or_kw_token_type(const char* identifer)
+static inline TokenType identifier_or_kw_token_type(const char* value, size_t length)
 {
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_VOID, "void");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_INT, "int");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_IF, "if");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_ELSE, "else");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_FOR, "for");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_WHILE, "while");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_SWITCH, "switch");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_CASE, "case");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_RETURN, "return");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_CONTINUE, "continue");
-    CHECK_KEYWORD(identifer, TOKEN_TYPE_KW_BREAK, "break");
-    return TOKEN_TYPE_IDENTIFIER;
+    switch (KEYWORD_KEY(length, (unsigned char) value[0])) {
+        KEYWORD_CASE('v', "void", TOKEN_TYPE_KW_VOID)
+        KEYWORD_CASE('i', "int", TOKEN_TYPE_KW_INT)
+        KEYWORD_CASE('i', "if", TOKEN_TYPE_KW_IF)
+        KEYWORD_CASE('e', "else", TOKEN_TYPE_KW_ELSE)
+        KEYWORD_CASE('f', "for", TOKEN_TYPE_KW_FOR)
+        KEYWORD_CASE('w', "while", TOKEN_TYPE_KW_WHILE)
+        KEYWORD_CASE('s', "switch", TOKEN_TYPE_KW_SWITCH)
+        KEYWORD_CASE('c', "case", TOKEN_TYPE_KW_CASE)
+        KEYWORD_CASE('r', "return", TOKEN_TYPE_KW_RETURN)
+        KEYWORD_CASE('c', "continue", TOKEN_TYPE_KW_CONTINUE)
+        KEYWORD_CASE('b', "break", TOKEN_TYPE_KW_BREAK)
+    default:
+        return TOKEN_TYPE_IDENTIFIER;
+    }
 }
 
-Token* lexer_make_name(Lexer* self)
+void lexer_make_name(Lexer* self)
 {
-    const char* value = &self->text[self->index];
-    size_t value_length = 1;
+    uint32_t start = self->index;
+    lexer_skip_run(self, CHAR_CLASS_NAME);
+    lexer_add(self, identifier_or_kw_token_type(&self->text[start], self->index - start), start);
+}
+
+void lexer_make_equal_or_assign(Lexer* self)
+{
+    uint32_t start = self->index;
     lexer_next(self);
-    while (!self->done && (is_digit(self->c) || is_letter(self->c))) {
-        value_length++;
+    if (self->c == '=') {
         lexer_next(self);
+        lexer_add(self, TOKEN_TYPE_EQUAL, start);
+        return;
     }
-    TokenType type = identifier_or_kw_token_type(value);
-    return new_token(type, value, value_length);
+    lexer_add(self, TOKEN_TYPE_ASSIGN, start);
 }
 
-Token* lexer_make_equal_or_assign(Lexer* self)
+// Operators of one char, or two when the second one makes a longer
+// operator, like < <= <<.
+void lexer_make_operator(Lexer* self)
 {
-    const char* value = &self->text[self->index];
+    uint32_t start = self->index;
+    char first = self->c;
     lexer_next(self);
-    if (self->c == '=') {
-        lexer_next(self);
-        return new_token(TOKEN_TYPE_EQUAL, value, 2);
+    TokenType type;
+    switch (first << 8 | self->c) {
+    case '!' << 8 | '=':
+        type = TOKEN_TYPE_NOT_EQUAL;
+        break;
+    case '<' << 8 | '<':
+        type = TOKEN_TYPE_LEFT_SHIFT;
+        break;
+    case '<' << 8 | '=':
+        type = TOKEN_TYPE_LESS_EQUAL;
+        break;
+    case '>' << 8 | '>':
+        type = TOKEN_TYPE_RIGHT_SHIFT;
+        break;
+    case '>' << 8 | '=':
+        type = TOKEN_TYPE_GREATER_EQUAL;
+        break;
+    case '&' << 8 | '&':
+        type = TOKEN_TYPE_AND;
+        break;
+    case '|' << 8 | '|':
+        type = TOKEN_TYPE_OR;
+        break;
+    default:
+        switch (first) {
+        case '!':
+            return lexer_add(self, TOKEN_TYPE_NOT, start);
+        case '+':
+            return lexer_add(self, TOKEN_TYPE_PLUS, start);
+        case '-':
+            return lexer_add(self, TOKEN_TYPE_MINUS, start);
+        case '*':
+            return lexer_add(self, TOKEN_TYPE_STAR, start);
+        case '/':
+            return lexer_add(self, TOKEN_TYPE_SLASH, start);
+        case '%':
+            return lexer_add(self, TOKEN_TYPE_PERCENT, start);
+        case '<':
+            return lexer_add(self, TOKEN_TYPE_LESS, start);
+        case '>':
+            return lexer_add(self, TOKEN_TYPE_GREATER, start);
+        case '&':
+            return lexer_add(self, TOKEN_TYPE_AMPERSAND, start);
+        case '^':
+            return lexer_add(self, TOKEN_TYPE_CARET, start);
+        case '|':
+            return lexer_add(self, TOKEN_TYPE_PIPE, start);
+        }
+        assert(!"unreachable");
     }
-    return new_token(TOKEN_TYPE_ASSIGN, value, 1);
+    lexer_next(self);
+    lexer_add(self, type, start);
 }
 
 void lexer_next(Lexer* self)
@@ -0,0 +1,81 @@
+#include "utils.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static void add_line_start(LineIndex* self, size_t offset)
+{
+    if (self->m_length == self->m_capacity) {
+        self->m_capacity *= 2;
+        self->m_line_starts = counted_realloc(self->m_line_starts, self->m_capacity * sizeof(uint32_t));
+        assert(self->m_line_starts && "could not allocate line starts");
+    }
+    self->m_line_starts[self->m_length++] = offset;
+}
+
+LineIndex* new_line_index(const char* text, size_t length)
+{
+    static_assert(sizeof(LineIndex) == 24, "incomplete construction of LineIndex");
+    assert(length <= UINT32_MAX && "line offsets are 32 bit");
+    LineIndex* self = counted_calloc(1, sizeof(LineIndex));
+    // lines of source are rarely shorter than this
+    size_t capacity = length / 32 + 16;
+    *self = (LineIndex) {
+        .m_length = 0,
+        .m_capacity = capacity,
+        .m_line_starts = counted_malloc(capacity * sizeof(uint32_t)),
+    };
+    assert(self->m_line_starts && "could not allocate line starts");
+    add_line_start(self, 0);
+
+    size_t index = 0;
+#ifdef __SSE2__
+    // 16 bytes at a time, every set bit of the mask is a '\n'
+    __m128i newline = _mm_set1_epi8('\n');
+    for (; index + 16 <= length; index += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) &text[index]), newline));
+        while (mask) {
+            add_line_start(self, index + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    // the rest, or everything where there is no SSE2
+    for (const char* end = text + length; index < length;) {
+        const char* found = memchr(&text[index], '\n', end - &text[index]);
+        if (!found)
+            break;
+        index = found - text + 1;
+        add_line_start(self, index);
+    }
+    return self;
+}
+
+void delete_line_index(LineIndex* self)
+{
+    free(self->m_line_starts);
+    free(self);
+}
+
+size_t line_index_lines_length(LineIndex* self)
+{
+    return self->m_length;
+}
+
+SourcePosition line_index_position(LineIndex* self, size_t offset)
+{
+    // the last line starting at or before offset
+    size_t low = 0;
+    size_t high = self->m_length;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (self->m_line_starts[middle] <= offset)
+            low = middle;
+        else
+            high = middle;
+    }
+    return (SourcePosition) { .line = low + 1, .column = offset - self->m_line_starts[low] + 1 };
+}
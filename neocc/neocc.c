@@ -4,38 +4,223 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 int main(int argc, char** argv)
 {
-    assert(argc >= 2 && "not enough args / no input file");
+    // every other argument is an input file, all are linked into one output
+    const char** input_paths = counted_calloc(argc, sizeof(const char*));
+    size_t input_paths_length = 0;
+    const char* output_path = "a.out";
+    // --direct encodes machine code and writes the executable without as/ld
+    bool direct = false;
+    // --run calls main in this process and exits with what it returns,
+    // without writing any files
+    bool run = false;
+    // --no-peephole leaves the instructions as the compiler emits them
+    bool peephole = true;
+    // -j N compiles functions on N threads
+    int jobs = 1;
+    // --dump-* print the intermediate results of each phase
+    bool dump_tokens = false;
+    bool dump_ast = false;
+    bool dump_ir = false;
+    bool dump_asm = false;
+    // --time-report prints time, peak memory and allocations per phase,
+    // --time-report-json PATH writes the same numbers as JSON
+    bool time_report = false;
+    const char* time_report_json_path = NULL;
+    // --cache DIR reuses the AST of files and the assembly of functions
+    // whose text is unchanged since an earlier run with the same directory
+    const char* cache_directory = NULL;
+    // --server SOCKET compiles whatever clients send over the socket until
+    // --stop-server SOCKET, --connect SOCKET has the server build a.out
+    const char* server_path = NULL;
+    const char* connect_path = NULL;
+    const char* stop_server_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--direct") == 0)
+            direct = true;
+        else if (strcmp(argv[i], "--run") == 0)
+            run = true;
+        else if (strcmp(argv[i], "--no-peephole") == 0)
+            peephole = false;
+        else if (strcmp(argv[i], "--dump-tokens") == 0)
+            dump_tokens = true;
+        else if (strcmp(argv[i], "--dump-ast") == 0)
+            dump_ast = true;
+        else if (strcmp(argv[i], "--dump-ir") == 0)
+            dump_ir = true;
+        else if (strcmp(argv[i], "--dump-asm") == 0)
+            dump_asm = true;
+        else if (strcmp(argv[i], "--time-report") == 0)
+            time_report = true;
+        else if (strcmp(argv[i], "--time-report-json") == 0 && i + 1 < argc)
+            time_report_json_path = argv[++i];
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cache_directory = argv[++i];
+        else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc)
+            server_path = argv[++i];
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+            connect_path = argv[++i];
+        else if (strcmp(argv[i], "--stop-server") == 0 && i + 1 < argc)
+            stop_server_path = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output_path = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (strncmp(argv[i], "-j", 2) == 0)
+            jobs = atoi(argv[i] + 2);
+        else
+            input_paths[input_paths_length++] = argv[i];
+    }
+    assert(jobs > 0 && "-j expects a positive number of jobs");
+
+    if (server_path) {
+        FunctionCache* cache = cache_directory ? new_function_cache(cache_directory) : NULL;
+        serve(server_path, jobs, cache);
+        if (cache)
+            delete_function_cache(cache);
+        return 0;
+    }
+    if (stop_server_path) {
+        int connection = server_connect(stop_server_path);
+        server_request(connection, SERVER_REQUEST_SHUTDOWN, NULL, 0, NULL, NULL);
+        close(connection);
+        return 0;
+    }
+    assert(input_paths_length > 0 && "not enough args / no input file");
+    if (connect_path) {
+        assert(input_paths_length == 1 && "--connect takes a single input file");
+        MappedFile* source = new_mapped_file(input_paths[0]);
+        int connection = server_connect(connect_path);
+        size_t length;
+        ServerStatus status;
+        char* output
+            = server_request(connection, SERVER_REQUEST_EXECUTABLE, source->text, source->length, &length, &status);
+        // on error the output is what the compiler printed
+        if (status == SERVER_STATUS_OK)
+            write_executable_file(output_path, output, length);
+        else
+            fwrite(output, 1, length, stderr);
+        free(output);
+        close(connection);
+        delete_mapped_file(source);
+        return status == SERVER_STATUS_OK ? 0 : 1;
+    }
 
-    char* content = read_file(argv[1]);
+    TimeReport* report = new_time_report();
 
-    List* tokens = tokenize(content);
-    printf("=== TOKENIZING(TEXT) -> TOKENS ===\n");
-    for (int i = 0; i < tokens->length(tokens); i++)
-        println_and_free(token_to_string(tokens->get(tokens, i)));
+    // cached functions were compiled with the peephole pass, so they are
+    // neither loaded nor stored without it
+    FunctionCache* cache = cache_directory && peephole ? new_function_cache(cache_directory) : NULL;
+    AstCache* ast_cache = cache_directory ? new_ast_cache(cache_directory) : NULL;
+    List* functions;
+    if (input_paths_length == 1) {
+        time_report_begin(report, "read_file");
+        MappedFile* source = new_mapped_file(input_paths[0]);
+        time_report_end(report);
 
-    printf("=== PARSING(TOKENS) -> AST ===\n");
-    List* ast = parse(tokens);
-    for (int i = 0; i < ast->length(ast); i++) {
-        StatementNode* node = (StatementNode*) ast->get(ast, i);
-        println_and_free(node->to_string(node));
-    }
+        if (dump_tokens) {
+            time_report_begin(report, "tokenize");
+            // the parser pulls tokens on demand, dumping them needs a separate pass
+            TokenBuffer* tokens = tokenize(source->text, source->length);
+            printf("=== TOKENIZING(TEXT) -> TOKENS ===\n");
+            for (size_t i = 0; i < token_buffer_length(tokens); i++) {
+                Token token = token_buffer_get(tokens, i);
+                println_and_free(token_to_string(&token));
+            }
+            delete_token_buffer(tokens);
+            time_report_end(report);
+        }
 
-    printf("=== COMPILING(AST) -> ASSEMBLY ===\n");
-    char* assembly = compile(ast);
-    printf("%s\n", assembly);
+        // the lexer runs inside the parser, so this phase covers both
+        time_report_begin(report, "parse");
+        Ast* ast = parse_file_cached(source, ast_cache);
+        if (dump_ast) {
+            printf("=== PARSING(TEXT) -> AST ===\n");
+            for (AstRef node = ast->statements; node != AST_NONE; node = ast_get(ast, node)->next)
+                println_and_free(ast_node_to_string(ast, node));
+        }
+        time_report_end(report);
 
-    write_file("temp.s", assembly);
+        time_report_begin(report, "lower");
+        functions = lower_cached(ast, jobs, cache);
+        time_report_end(report);
+        time_report_begin(report, "optimize");
+        optimize(functions, jobs);
+        time_report_end(report);
+        delete_ast(ast);
+        delete_mapped_file(source);
+    } else {
+        assert(!dump_tokens && !dump_ast && "--dump-tokens and --dump-ast take a single input file");
+        // files go through the front end in parallel, so the phases can't be told apart
+        time_report_begin(report, "front_end");
+        functions = lower_files(input_paths, input_paths_length, jobs, cache, ast_cache);
+        time_report_end(report);
+    }
+    if (dump_ir) {
+        printf("=== LOWERING(AST) -> IR ===\n");
+        for (int i = 0; i < functions->length(functions); i++)
+            println_and_free(ir_function_to_string(functions->get(functions, i)));
+    }
+
+    time_report_begin(report, "compile");
+    Compiler* compiler = new_compiler(functions);
+    compiler->jobs = jobs;
+    compiler->peephole = peephole;
+    compiler_compile(compiler);
+    if (dump_asm) {
+        printf("=== COMPILING(IR) -> ASSEMBLY ===\n");
+        println_and_free(assembly_to_string(compiler->assembly));
+    }
+    int exit_code = 0;
+    if (run) {
+        time_report_end(report);
+        time_report_begin(report, "run");
+        exit_code = jit_run(compiler->assembly);
+        time_report_end(report);
+    } else if (direct) {
+        // encoding and writing the executable count as compiling
+        StringBuilder* bytes = new_string_builder();
+        assembly_write_executable(compiler->assembly, bytes);
+        write_executable_file(output_path, string_builder_buffer(bytes), string_builder_length(bytes));
+        delete_string_builder(bytes);
+        time_report_end(report);
+    } else {
+        char* assembly = assembly_to_string(compiler->assembly);
+        write_file("temp.s", assembly);
+        free(assembly);
+        time_report_end(report);
 
-    int assembler_exit_code = system("as temp.s -o temp.o --warn --fatal-warnings");
-    assert(assembler_exit_code == 0);
-    int linker_exit_code = system("ld temp.o -o a.out");
-    assert(linker_exit_code == 0);
+        time_report_begin(report, "assemble");
+        int assembler_exit_code = system("as temp.s -o temp.o --warn --fatal-warnings");
+        assert(assembler_exit_code == 0);
+        time_report_end(report);
+        time_report_begin(report, "link");
+        StringBuilder* command = new_string_builder();
+        string_builder_write_fmt(command, "ld temp.o -o %s", output_path);
+        int linker_exit_code = system(string_builder_buffer(command));
+        delete_string_builder(command);
+        assert(linker_exit_code == 0);
+        time_report_end(report);
+    }
+    delete_compiler(compiler);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    free(input_paths);
+    if (cache)
+        delete_function_cache(cache);
+    if (ast_cache)
+        delete_ast_cache(ast_cache);
 
-    free(assembly);
-    list_delete_all_and_self(ast, (void (*)(void*)) delete_node_inheriter);
-    list_delete_all_and_self(tokens, (void (*)(void*)) delete_token);
-    free(content);
+    if (time_report)
+        time_report_print(report, stderr);
+    if (time_report_json_path) {
+        char* json = time_report_to_json(report);
+        write_file(time_report_json_path, json);
+        free(json);
+    }
+    delete_time_report(report);
+    return exit_code;
 }
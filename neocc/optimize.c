@@ -0,0 +1,468 @@
+#include "ir.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+static inline int blocks_length(IrFunction* function)
+{
+    return function->blocks->length(function->blocks);
+}
+
+static inline bool has_destination(IrInstruction* instruction)
+{
+    switch (instruction->opcode) {
+    case IR_OPCODE_CONST:
+    case IR_OPCODE_COPY:
+    case IR_OPCODE_ADD:
+    case IR_OPCODE_SUB:
+    case IR_OPCODE_MUL:
+    case IR_OPCODE_DIV:
+    case IR_OPCODE_MOD:
+    case IR_OPCODE_SHL:
+    case IR_OPCODE_SHR:
+    case IR_OPCODE_AND:
+    case IR_OPCODE_OR:
+    case IR_OPCODE_XOR:
+    case IR_OPCODE_EQ:
+    case IR_OPCODE_NE:
+    case IR_OPCODE_LT:
+    case IR_OPCODE_LE:
+    case IR_OPCODE_GT:
+    case IR_OPCODE_GE:
+    case IR_OPCODE_PHI:
+        return true;
+    case IR_OPCODE_NOP:
+    case IR_OPCODE_JUMP:
+    case IR_OPCODE_BRANCH:
+    case IR_OPCODE_RETURN:
+        return false;
+    }
+    assert(!"unreachable");
+}
+
+// The blocks the terminator of block continues in, returns how many.
+static int successors(IrBlock* block, int* result)
+{
+    IrInstruction* terminator = ir_block_terminator(block);
+    if (!terminator || terminator->opcode == IR_OPCODE_RETURN)
+        return 0;
+    result[0] = terminator->value;
+    if (terminator->opcode == IR_OPCODE_JUMP || terminator->right == terminator->value)
+        return 1;
+    result[1] = terminator->right;
+    return 2;
+}
+
+// Drops the operands of the phis in block that come from predecessor.
+static void drop_phi_operands(IrFunction* function, IrBlock* block, int predecessor)
+{
+    for (size_t j = 0; j < block->m_length; j++) {
+        IrInstruction* phi = &block->m_instructions[j];
+        if (phi->opcode != IR_OPCODE_PHI)
+            continue;
+        int* pairs = &function->phi_operands[phi->left];
+        int kept = 0;
+        for (int k = 0; k < phi->right; k++) {
+            if (pairs[k * 2] == predecessor)
+                continue;
+            pairs[kept * 2] = pairs[k * 2];
+            pairs[kept * 2 + 1] = pairs[k * 2 + 1];
+            kept++;
+        }
+        phi->right = kept;
+    }
+}
+
+// Only the successors of a block have phis naming it, so these look at
+// them instead of every block.
+static void for_each_successor_phi_drop_block(IrFunction* function, IrBlock* removed_block)
+{
+    int targets[2];
+    int targets_length = successors(removed_block, targets);
+    for (int i = 0; i < targets_length; i++)
+        drop_phi_operands(function, ir_function_block(function, targets[i]), removed_block->id);
+}
+
+static void for_each_successor_phi_rename_block(IrFunction* function, IrBlock* block, int from, int to)
+{
+    int targets[2];
+    int targets_length = successors(block, targets);
+    for (int i = 0; i < targets_length; i++) {
+        IrBlock* successor = ir_function_block(function, targets[i]);
+        for (size_t j = 0; j < successor->m_length; j++) {
+            IrInstruction* phi = &successor->m_instructions[j];
+            if (phi->opcode != IR_OPCODE_PHI)
+                continue;
+            for (int k = 0; k < phi->right; k++)
+                if (function->phi_operands[phi->left + k * 2] == from)
+                    function->phi_operands[phi->left + k * 2] = to;
+        }
+    }
+}
+
+// How many blocks jump or branch to each block.
+static int* count_predecessors(IrFunction* function)
+{
+    int length = blocks_length(function);
+    int* predecessors = counted_calloc(length + 1, sizeof(int));
+    for (int i = 0; i < length; i++) {
+        IrBlock* block = ir_function_block(function, i);
+        int targets[2];
+        int targets_length = block->removed ? 0 : successors(block, targets);
+        for (int j = 0; j < targets_length; j++)
+            predecessors[targets[j]]++;
+    }
+    return predecessors;
+}
+
+// Forgets that block from continues in block to, and removes to when that
+// was the last way into it, and so on for the blocks it continues in. This
+// lets the rest of a pass see the phis of the blocks after it with one
+// operand less, instead of waiting for remove_unreachable_blocks.
+static void remove_edge(IrFunction* function, int* predecessors, int from, int to)
+{
+    size_t edges_capacity = 8;
+    size_t edges_length = 0;
+    int* edges = counted_malloc(sizeof(int) * 2 * edges_capacity);
+    edges[edges_length * 2] = from;
+    edges[edges_length * 2 + 1] = to;
+    edges_length++;
+    while (edges_length > 0) {
+        edges_length--;
+        from = edges[edges_length * 2];
+        to = edges[edges_length * 2 + 1];
+        IrBlock* block = ir_function_block(function, to);
+        drop_phi_operands(function, block, from);
+        // the entry has no predecessors to begin with
+        if (--predecessors[to] > 0 || to == 0)
+            continue;
+        block->removed = true;
+        int targets[2];
+        int targets_length = successors(block, targets);
+        for (int i = 0; i < targets_length; i++) {
+            if (edges_length == edges_capacity) {
+                edges_capacity *= 2;
+                edges = counted_realloc(edges, sizeof(int) * 2 * edges_capacity);
+            }
+            edges[edges_length * 2] = to;
+            edges[edges_length * 2 + 1] = targets[i];
+            edges_length++;
+        }
+    }
+    free(edges);
+}
+
+static bool remove_unreachable_blocks(IrFunction* function)
+{
+    int length = blocks_length(function);
+    bool* reachable = counted_calloc(length, sizeof(bool));
+    int* worklist = counted_calloc(length, sizeof(int));
+    int worklist_length = 0;
+    reachable[0] = true;
+    worklist[worklist_length++] = 0;
+    while (worklist_length > 0) {
+        int targets[2];
+        int targets_length = successors(ir_function_block(function, worklist[--worklist_length]), targets);
+        for (int i = 0; i < targets_length; i++) {
+            if (reachable[targets[i]])
+                continue;
+            reachable[targets[i]] = true;
+            worklist[worklist_length++] = targets[i];
+        }
+    }
+    bool changed = false;
+    for (int i = 0; i < length; i++) {
+        IrBlock* block = ir_function_block(function, i);
+        if (reachable[i] || block->removed)
+            continue;
+        block->removed = true;
+        for_each_successor_phi_drop_block(function, block);
+        changed = true;
+    }
+    free(worklist);
+    free(reachable);
+    return changed;
+}
+
+// Appends a block to its only predecessor, when that ends by jumping to it.
+static bool merge_blocks(IrFunction* function)
+{
+    int length = blocks_length(function);
+    int* predecessors = count_predecessors(function);
+    bool changed = false;
+    for (int i = 0; i < length; i++) {
+        IrBlock* block = ir_function_block(function, i);
+        if (block->removed)
+            continue;
+        IrInstruction* terminator;
+        while ((terminator = ir_block_terminator(block)) && terminator->opcode == IR_OPCODE_JUMP
+            && terminator->value != block->id && predecessors[terminator->value] == 1) {
+            IrBlock* successor = ir_function_block(function, terminator->value);
+            block->m_length--;
+            for (size_t j = 0; j < successor->m_length; j++) {
+                IrInstruction instruction = successor->m_instructions[j];
+                if (instruction.opcode == IR_OPCODE_PHI) {
+                    assert(instruction.right == 1 && "phi incoming count does not match predecessors");
+                    instruction.opcode = IR_OPCODE_COPY;
+                    instruction.left = function->phi_operands[instruction.left + 1];
+                }
+                ir_block_add(block, instruction);
+            }
+            successor->m_length = 0;
+            successor->removed = true;
+            for_each_successor_phi_rename_block(function, block, successor->id, block->id);
+            changed = true;
+        }
+    }
+    free(predecessors);
+    return changed;
+}
+
+static inline int resolve(int* replacements, int reg)
+{
+    while (replacements[reg] != reg)
+        reg = replacements[reg];
+    return reg;
+}
+
+// Evaluates a binary operation on constants like the generated code would,
+// except for the ones that trap, which are left for run time.
+static bool fold(IrOpcode opcode, int32_t left, int32_t right, int32_t* result)
+{
+    // wrapping arithmetic through unsigned, signed overflow is undefined
+    uint32_t left_bits = (uint32_t) left, right_bits = (uint32_t) right;
+    switch (opcode) {
+    case IR_OPCODE_ADD:
+        *result = (int32_t) (left_bits + right_bits);
+        return true;
+    case IR_OPCODE_SUB:
+        *result = (int32_t) (left_bits - right_bits);
+        return true;
+    case IR_OPCODE_MUL:
+        *result = (int32_t) (left_bits * right_bits);
+        return true;
+    case IR_OPCODE_DIV:
+    case IR_OPCODE_MOD:
+        if (right == 0 || (left == INT32_MIN && right == -1))
+            return false;
+        *result = opcode == IR_OPCODE_DIV ? left / right : left % right;
+        return true;
+    case IR_OPCODE_SHL:
+        // the shift count is masked like x86 does
+        *result = (int32_t) (left_bits << (right & 31));
+        return true;
+    case IR_OPCODE_SHR:
+        *result = left >> (right & 31);
+        return true;
+    case IR_OPCODE_AND:
+        *result = left & right;
+        return true;
+    case IR_OPCODE_OR:
+        *result = left | right;
+        return true;
+    case IR_OPCODE_XOR:
+        *result = left ^ right;
+        return true;
+    case IR_OPCODE_EQ:
+        *result = left == right;
+        return true;
+    case IR_OPCODE_NE:
+        *result = left != right;
+        return true;
+    case IR_OPCODE_LT:
+        *result = left < right;
+        return true;
+    case IR_OPCODE_LE:
+        *result = left <= right;
+        return true;
+    case IR_OPCODE_GT:
+        *result = left > right;
+        return true;
+    case IR_OPCODE_GE:
+        *result = left >= right;
+        return true;
+    case IR_OPCODE_NOP:
+    case IR_OPCODE_CONST:
+    case IR_OPCODE_COPY:
+    case IR_OPCODE_PHI:
+    case IR_OPCODE_JUMP:
+    case IR_OPCODE_BRANCH:
+    case IR_OPCODE_RETURN:
+        return false;
+    }
+    assert(!"unreachable");
+}
+
+// Constant folding and copy propagation, uses of a copy are replaced by
+// its source until only the copies themselves remain for dead code
+// elimination.
+static bool fold_and_propagate(IrFunction* function)
+{
+    IrInstruction** definitions = counted_calloc(function->registers_length, sizeof(IrInstruction*));
+    int* replacements = counted_calloc(function->registers_length, sizeof(int));
+    int* predecessors = count_predecessors(function);
+    for (int i = 0; i < function->registers_length; i++)
+        replacements[i] = i;
+    for (int i = 0; i < blocks_length(function); i++) {
+        IrBlock* block = ir_function_block(function, i);
+        for (size_t j = 0; !block->removed && j < block->m_length; j++) {
+            IrInstruction* instruction = &block->m_instructions[j];
+            if (has_destination(instruction))
+                definitions[instruction->destination] = instruction;
+            if (instruction->opcode == IR_OPCODE_COPY)
+                replacements[instruction->destination] = instruction->left;
+        }
+    }
+
+    bool changed = false;
+    for (int i = 0; i < blocks_length(function); i++) {
+        IrBlock* block = ir_function_block(function, i);
+        for (size_t j = 0; !block->removed && j < block->m_length; j++) {
+            IrInstruction* instruction = &block->m_instructions[j];
+            int* use;
+            for (int k = 0; (use = ir_function_use(function, instruction, k)); k++) {
+                int replacement = resolve(replacements, *use);
+                if (replacement != *use) {
+                    *use = replacement;
+                    changed = true;
+                }
+            }
+
+            if (ir_opcode_is_binary(instruction->opcode)) {
+                IrInstruction* left = definitions[instruction->left];
+                IrInstruction* right = definitions[instruction->right];
+                int32_t value;
+                if (left && right && left->opcode == IR_OPCODE_CONST && right->opcode == IR_OPCODE_CONST
+                    && fold(instruction->opcode, left->value, right->value, &value)) {
+                    instruction->opcode = IR_OPCODE_CONST;
+                    instruction->value = value;
+                    changed = true;
+                }
+            } else if (instruction->opcode == IR_OPCODE_BRANCH) {
+                IrInstruction* condition = definitions[instruction->left];
+                if (condition && condition->opcode == IR_OPCODE_CONST) {
+                    int taken = condition->value != 0 ? instruction->value : instruction->right;
+                    int skipped = condition->value != 0 ? instruction->right : instruction->value;
+                    *instruction = (IrInstruction) { .opcode = IR_OPCODE_JUMP, .value = taken };
+                    if (skipped != taken)
+                        remove_edge(function, predecessors, block->id, skipped);
+                    changed = true;
+                }
+            } else if (instruction->opcode == IR_OPCODE_PHI && instruction->right > 0) {
+                // a phi choosing between equal values is a copy
+                int* pairs = &function->phi_operands[instruction->left];
+                bool same = true;
+                for (int k = 1; k < instruction->right; k++)
+                    same = same && pairs[k * 2 + 1] == pairs[1];
+                if (same) {
+                    instruction->opcode = IR_OPCODE_COPY;
+                    instruction->left = pairs[1];
+                    replacements[instruction->destination] = instruction->left;
+                    changed = true;
+                }
+            }
+        }
+    }
+    free(predecessors);
+    free(replacements);
+    free(definitions);
+    return changed;
+}
+
+static bool eliminate_dead_code(IrFunction* function)
+{
+    int* uses = counted_calloc(function->registers_length, sizeof(int));
+    for (int i = 0; i < blocks_length(function); i++) {
+        IrBlock* block = ir_function_block(function, i);
+        for (size_t j = 0; !block->removed && j < block->m_length; j++) {
+            int* use;
+            for (int k = 0; (use = ir_function_use(function, &block->m_instructions[j], k)); k++)
+                uses[*use]++;
+        }
+    }
+
+    // backwards, so whole chains of unused values go in one sweep
+    bool changed = false;
+    for (int i = blocks_length(function) - 1; i >= 0; i--) {
+        IrBlock* block = ir_function_block(function, i);
+        if (block->removed)
+            continue;
+        size_t kept = block->m_length;
+        for (size_t j = block->m_length; j-- > 0;) {
+            IrInstruction* instruction = &block->m_instructions[j];
+            if (!has_destination(instruction) || uses[instruction->destination] > 0)
+                continue;
+            int* use;
+            for (int k = 0; (use = ir_function_use(function, instruction, k)); k++)
+                uses[*use]--;
+            instruction->opcode = IR_OPCODE_NOP;
+            kept--;
+            changed = true;
+        }
+        if (kept == block->m_length)
+            continue;
+        size_t length = 0;
+        for (size_t j = 0; j < block->m_length; j++)
+            if (block->m_instructions[j].opcode != IR_OPCODE_NOP)
+                block->m_instructions[length++] = block->m_instructions[j];
+        block->m_length = length;
+    }
+    free(uses);
+    return changed;
+}
+
+void optimize_function(IrFunction* function)
+{
+    if (function->cached_assembly)
+        return;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        changed |= remove_unreachable_blocks(function);
+        changed |= merge_blocks(function);
+        changed |= fold_and_propagate(function);
+        changed |= eliminate_dead_code(function);
+    }
+}
+
+static void optimize_job(void* context, size_t index)
+{
+    List* functions = context;
+    optimize_function(functions->get(functions, index));
+}
+
+void optimize(List* functions, int jobs)
+{
+    parallel_for(functions->length(functions), jobs, optimize_job, functions);
+}
+
+void lower_phis(IrFunction* function)
+{
+    for (int i = 0; i < blocks_length(function); i++) {
+        IrBlock* block = ir_function_block(function, i);
+        for (size_t j = 0; !block->removed && j < block->m_length; j++) {
+            IrInstruction phi = block->m_instructions[j];
+            if (phi.opcode != IR_OPCODE_PHI)
+                continue;
+            block->m_instructions[j].opcode = IR_OPCODE_NOP;
+            for (int k = 0; k < phi.right; k++) {
+                IrBlock* predecessor = ir_function_block(function, function->phi_operands[phi.left + k * 2]);
+                IrInstruction* terminator = ir_block_terminator(predecessor);
+                assert(terminator && terminator->opcode != IR_OPCODE_RETURN && "phi predecessor does not jump");
+                // a branch only reads its condition, which the copy
+                // doesn't assign, and phi results are only read after the
+                // phi, so the other way out doesn't mind the copy either
+                IrInstruction jump = *terminator;
+                *terminator = (IrInstruction) {
+                    .opcode = IR_OPCODE_COPY,
+                    .type = phi.type,
+                    .destination = phi.destination,
+                    .left = function->phi_operands[phi.left + k * 2 + 1],
+                };
+                ir_block_add(predecessor, jump);
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#include "utils.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+typedef struct ParallelFor {
+    atomic_size_t next;
+    size_t count;
+    void (*work)(void* context, size_t index);
+    void* context;
+} ParallelFor;
+
+static void* parallel_for_worker(void* data)
+{
+    ParallelFor* self = data;
+    size_t index;
+    while ((index = atomic_fetch_add(&self->next, 1)) < self->count)
+        self->work(self->context, index);
+    return NULL;
+}
+
+void parallel_for(size_t count, int jobs, void (*work)(void* context, size_t index), void* context)
+{
+    ParallelFor self = {
+        .next = 0,
+        .count = count,
+        .work = work,
+        .context = context,
+    };
+    if (jobs > (int) count)
+        jobs = (int) count;
+    if (jobs <= 1) {
+        parallel_for_worker(&self);
+        return;
+    }
+    // the calling thread is one of the workers
+    pthread_t* threads = counted_calloc(jobs - 1, sizeof(pthread_t));
+    for (int i = 0; i < jobs - 1; i++) {
+        int result = pthread_create(&threads[i], NULL, parallel_for_worker, &self);
+        assert(result == 0 && "could not create thread");
+    }
+    parallel_for_worker(&self);
+    for (int i = 0; i < jobs - 1; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+}
@@ -5,184 +5,432 @@
 #include <stdlib.h>
 #include <string.h>
 
-Parser* new_parser(List* tokens)
+Parser* new_parser(Ast* ast, const char* text, size_t length)
 {
-    Parser* self = calloc(1, sizeof(Parser));
+    static_assert(sizeof(Parser) == 96 + sizeof(Token) * PARSER_LOOKAHEAD, "incomplete construction of Parser");
+    Parser* self = counted_calloc(1, sizeof(Parser));
     *self = (Parser) {
-        .tokens = tokens,
-        .index = 0,
-        .t = tokens->get(tokens, 0),
+        .ast = ast,
+        .lexer = new_lexer(text, length),
+        .path = NULL,
+        .lines = NULL,
+        .head = 0,
         .done = false,
+        .m_operands_length = 0,
+        .m_operands_capacity = 0,
+        .m_operands = NULL,
+        .m_operators_length = 0,
+        .m_operators_capacity = 0,
+        .m_operators = NULL,
     };
+    for (size_t i = 0; i < PARSER_LOOKAHEAD; i++) {
+        lexer_next_token(self->lexer);
+        self->lookahead[i] = self->lexer->token;
+    }
+    self->done = self->lookahead[0].type == TOKEN_TYPE_EOF;
     return self;
 }
 
 void delete_parser(Parser* self)
 {
+    delete_lexer(self->lexer);
+    free(self->m_operands);
+    free(self->m_operators);
     free(self);
 }
 
-List* parser_parse(Parser* self)
+static inline TokenType parser_type(Parser* self)
+{
+    return self->lookahead[self->head].type;
+}
+
+static inline Token parser_token(Parser* self)
+{
+    return self->lookahead[self->head];
+}
+
+Token parser_peek(Parser* self, size_t distance)
+{
+    assert(distance < PARSER_LOOKAHEAD && "peeking further than the lookahead");
+    return self->lookahead[(self->head + distance) & (PARSER_LOOKAHEAD - 1)];
+}
+
+// Adds a node for token, which lies in the text of the ast.
+static AstRef add_token_node(Parser* self, AstKind kind, Token token, AstRef first, AstRef second)
+{
+    return ast_add(self->ast, (AstNode) {
+        .kind = kind,
+        .token_type = token.type,
+        .operation_type = 0,
+        .offset = token.value - self->ast->text,
+        .length = token.length,
+        .next = AST_NONE,
+        .first = first,
+        .second = second,
+    });
+}
+
+static AstRef add_node(Parser* self, AstKind kind, int operation_type, AstRef first, AstRef second)
+{
+    return ast_add(self->ast, (AstNode) {
+        .kind = kind,
+        .token_type = 0,
+        .operation_type = operation_type,
+        .offset = 0,
+        .length = 0,
+        .next = AST_NONE,
+        .first = first,
+        .second = second,
+    });
+}
+
+AstRef parser_parse(Parser* self)
 {
     return parser_make_statements(self);
 }
 
-List* parser_make_statements(Parser* self)
+AstRef parser_make_statements(Parser* self)
 {
-    List* statements = (List*) new_array_list();
-    while (!self->done && self->t->type != TOKEN_TYPE_RBRACE)
-        statements->add(statements, parser_make_statement(self));
-    if (self->t->type == TOKEN_TYPE_RBRACE)
+    AstRef first = AST_NONE;
+    AstRef last = AST_NONE;
+    while (!self->done && parser_type(self) != TOKEN_TYPE_RBRACE) {
+        AstRef statement = parser_make_statement(self);
+        if (last != AST_NONE)
+            ast_get(self->ast, last)->next = statement;
+        else
+            first = statement;
+        last = statement;
+    }
+    if (parser_type(self) == TOKEN_TYPE_RBRACE)
         parser_next(self);
-    return statements;
+    return first;
 }
 
-StatementNode* parser_make_statement(Parser* self)
+AstRef parser_make_statement(Parser* self)
 {
-    StatementNode* result;
-    switch (self->t->type) {
+    switch (parser_type(self)) {
     case TOKEN_TYPE_KW_RETURN:
-        result = (StatementNode*) parser_make_return(self);
-        break;
+        return parser_make_return(self);
     case TOKEN_TYPE_KW_VOID:
     case TOKEN_TYPE_KW_INT:
-        result = parser_make_declaration_definition_or_initialization(self);
-        break;
+        return parser_make_declaration_definition_or_initialization(self);
     default:
-        assert(!"unexpected token type");
+        parser_error(self, "unexpected token");
     }
-    return result;
 }
 
-ReturnNode* parser_make_return(Parser* self)
+AstRef parser_make_return(Parser* self)
 {
     parser_next(self);
-    ExpressionNode* value = parser_make_expression(self);
+    AstRef value = parser_make_expression(self);
     check_and_skip_newline(self);
-    return new_return_node(value);
+    return add_node(self, AST_KIND_RETURN, 0, value, AST_NONE);
 }
 
-StatementNode* parser_make_declaration_definition_or_initialization(Parser* self)
+AstRef parser_make_declaration_definition_or_initialization(Parser* self)
 {
-    TypeNode* type = parser_make_type(self);
-    if (self->t->type != TOKEN_TYPE_IDENTIFIER)
-        assert(!"unexpected token, expected identifier");
-    Token* target = self->t;
+    const char* start = parser_token(self).value;
+    AstRef type = parser_make_type(self);
+    if (parser_type(self) != TOKEN_TYPE_IDENTIFIER)
+        parser_error(self, "unexpected token, expected identifier");
+    Token target = parser_token(self);
     parser_next(self);
-    if (self->t->type == TOKEN_TYPE_LPAREN)
-        return (StatementNode*) parser_resume_function_definition(self, target, type);
-    return (StatementNode*) parser_resume_declaration_statement(self, target, type);
+    if (parser_type(self) == TOKEN_TYPE_LPAREN)
+        return parser_resume_function_definition(self, target, type, start);
+    return parser_resume_declaration_statement(self, target, type);
 }
 
-FuncDefNode* parser_resume_function_definition(Parser* self, Token* target, TypeNode* type)
+AstRef parser_resume_function_definition(Parser* self, Token target, AstRef type, const char* start)
 {
+    AstRef declaration = add_token_node(self, AST_KIND_DECLARATION, target, type, AST_NONE);
     parser_next(self);
-    if (self->t->type != TOKEN_TYPE_RPAREN)
-        assert(!"unexpected token, expected ')', parameters not implemented btw");
+    if (parser_type(self) != TOKEN_TYPE_RPAREN)
+        parser_error(self, "unexpected token, expected ')', parameters not implemented btw");
     parser_next(self);
-    if (self->t->type != TOKEN_TYPE_LBRACE)
-        assert(!"unexpected token, expected '{'");
+    if (parser_type(self) != TOKEN_TYPE_LBRACE)
+        parser_error(self, "unexpected token, expected '{'");
     parser_next(self);
-    List* body = parser_make_statements(self);
-    return new_func_def_node(target, type, (List*) new_array_list(), body);
+    AstRef body = parser_make_statements(self);
+    // up to the next token, without the whitespace before it
+    const char* end = parser_token(self).value;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+    Token source = { .type = ast_get(self->ast, type)->token_type, .value = start, .length = end - start };
+    return add_token_node(self, AST_KIND_FUNC_DEF, source, declaration, body);
 }
 
-DeclStmtNode* parser_resume_declaration_statement(Parser* self, Token* target, TypeNode* type)
+static AstRef parser_resume_declaration(Parser* self, Token target, AstRef type)
 {
-    List* declarations = (List*) new_array_list();
-    if (self->t->type == TOKEN_TYPE_ASSIGN) {
-        parser_next(self);
-        ExpressionNode* value = parser_make_expression(self);
-        declarations->add(declarations, new_initialization_node(type, target, value));
-    } else {
-        declarations->add(declarations, new_declaration_node(type, target));
-    }
-    while (self->t->type == TOKEN_TYPE_COMMA) {
-        TypeNode* type = parser_make_type(self);
-        Token* target = self->t;
+    if (parser_type(self) != TOKEN_TYPE_ASSIGN)
+        return add_token_node(self, AST_KIND_DECLARATION, target, type, AST_NONE);
+    parser_next(self);
+    AstRef value = parser_make_expression(self);
+    return add_token_node(self, AST_KIND_INITIALIZATION, target, type, value);
+}
+
+AstRef parser_resume_declaration_statement(Parser* self, Token target, AstRef type)
+{
+    AstRef first = parser_resume_declaration(self, target, type);
+    AstRef last = first;
+    while (parser_type(self) == TOKEN_TYPE_COMMA) {
+        AstRef type = parser_make_type(self);
+        Token target = parser_token(self);
         parser_next(self);
-        if (self->t->type == TOKEN_TYPE_ASSIGN) {
-            parser_next(self);
-            ExpressionNode* value = parser_make_expression(self);
-            declarations->add(declarations, new_initialization_node(type, target, value));
-        } else {
-            declarations->add(declarations, new_declaration_node(type, target));
-        }
+        AstRef declaration = parser_resume_declaration(self, target, type);
+        ast_get(self->ast, last)->next = declaration;
+        last = declaration;
     }
     check_and_skip_newline(self);
-    return new_declaration_statement_node(declarations);
+    return add_node(self, AST_KIND_DECLARATION_STATEMENT, 0, first, AST_NONE);
 }
 
-TypeNode* parser_make_type(Parser* self)
+AstRef parser_make_type(Parser* self)
 {
-    Token* token = self->t;
+    Token token = parser_token(self);
     parser_next(self);
-    switch (token->type) {
+    switch (token.type) {
     case TOKEN_TYPE_KW_VOID:
-        return (TypeNode*) new_keyword_type_node(token);
     case TOKEN_TYPE_KW_INT:
-        return (TypeNode*) new_keyword_type_node(token);
+        return add_token_node(self, AST_KIND_KEYWORD_TYPE, token, AST_NONE, AST_NONE);
     default:
-        assert(!"unexpected token type");
+        parser_error(self, "unexpected token");
     }
 }
 
-ExpressionNode* parser_make_expression(Parser* self)
+// on the operator stack, below the operators inside the parentheses
+#define PARENTHESIS_MARKER -1
+
+// Returns the operation of a binary operator token, or -1 for any other
+// token.
+static inline int binary_operation_of(TokenType type)
 {
-    return parser_make_addition(self);
+    switch (type) {
+    case TOKEN_TYPE_STAR:
+        return BINARY_OPERATION_TYPE_MULTIPLY;
+    case TOKEN_TYPE_SLASH:
+        return BINARY_OPERATION_TYPE_DIVIDE;
+    case TOKEN_TYPE_PERCENT:
+        return BINARY_OPERATION_TYPE_MODULO;
+    case TOKEN_TYPE_PLUS:
+        return BINARY_OPERATION_TYPE_ADD;
+    case TOKEN_TYPE_MINUS:
+        return BINARY_OPERATION_TYPE_SUBTRACT;
+    case TOKEN_TYPE_LEFT_SHIFT:
+        return BINARY_OPERATION_TYPE_LEFT_SHIFT;
+    case TOKEN_TYPE_RIGHT_SHIFT:
+        return BINARY_OPERATION_TYPE_RIGHT_SHIFT;
+    case TOKEN_TYPE_LESS:
+        return BINARY_OPERATION_TYPE_LESS;
+    case TOKEN_TYPE_LESS_EQUAL:
+        return BINARY_OPERATION_TYPE_LESS_EQUAL;
+    case TOKEN_TYPE_GREATER:
+        return BINARY_OPERATION_TYPE_GREATER;
+    case TOKEN_TYPE_GREATER_EQUAL:
+        return BINARY_OPERATION_TYPE_GREATER_EQUAL;
+    case TOKEN_TYPE_EQUAL:
+        return BINARY_OPERATION_TYPE_EQUAL;
+    case TOKEN_TYPE_NOT_EQUAL:
+        return BINARY_OPERATION_TYPE_NOT_EQUAL;
+    case TOKEN_TYPE_AMPERSAND:
+        return BINARY_OPERATION_TYPE_BITWISE_AND;
+    case TOKEN_TYPE_CARET:
+        return BINARY_OPERATION_TYPE_BITWISE_XOR;
+    case TOKEN_TYPE_PIPE:
+        return BINARY_OPERATION_TYPE_BITWISE_OR;
+    case TOKEN_TYPE_AND:
+        return BINARY_OPERATION_TYPE_LOGICAL_AND;
+    case TOKEN_TYPE_OR:
+        return BINARY_OPERATION_TYPE_LOGICAL_OR;
+    default:
+        return -1;
+    }
+}
+
+// Higher binds tighter, as in C.
+static inline int precedence(BinaryOperationType type)
+{
+    switch (type) {
+    case BINARY_OPERATION_TYPE_MULTIPLY:
+    case BINARY_OPERATION_TYPE_DIVIDE:
+    case BINARY_OPERATION_TYPE_MODULO:
+        return 10;
+    case BINARY_OPERATION_TYPE_ADD:
+    case BINARY_OPERATION_TYPE_SUBTRACT:
+        return 9;
+    case BINARY_OPERATION_TYPE_LEFT_SHIFT:
+    case BINARY_OPERATION_TYPE_RIGHT_SHIFT:
+        return 8;
+    case BINARY_OPERATION_TYPE_LESS:
+    case BINARY_OPERATION_TYPE_LESS_EQUAL:
+    case BINARY_OPERATION_TYPE_GREATER:
+    case BINARY_OPERATION_TYPE_GREATER_EQUAL:
+        return 7;
+    case BINARY_OPERATION_TYPE_EQUAL:
+    case BINARY_OPERATION_TYPE_NOT_EQUAL:
+        return 6;
+    case BINARY_OPERATION_TYPE_BITWISE_AND:
+        return 5;
+    case BINARY_OPERATION_TYPE_BITWISE_XOR:
+        return 4;
+    case BINARY_OPERATION_TYPE_BITWISE_OR:
+        return 3;
+    case BINARY_OPERATION_TYPE_LOGICAL_AND:
+        return 2;
+    case BINARY_OPERATION_TYPE_LOGICAL_OR:
+        return 1;
+    }
+    assert(!"unreachable");
 }
 
-ExpressionNode* parser_make_addition(Parser* self)
+static inline void push_operand(Parser* self, AstRef operand)
 {
-    ExpressionNode* left = parser_make_value(self);
-    if (self->t->type == TOKEN_TYPE_PLUS) {
+    if (self->m_operands_length == self->m_operands_capacity) {
+        self->m_operands_capacity = self->m_operands_capacity ? self->m_operands_capacity * 2 : 16;
+        self->m_operands = counted_realloc(self->m_operands, sizeof(AstRef) * self->m_operands_capacity);
+    }
+    self->m_operands[self->m_operands_length++] = operand;
+}
+
+static inline void push_operator(Parser* self, int operator)
+{
+    if (self->m_operators_length == self->m_operators_capacity) {
+        self->m_operators_capacity = self->m_operators_capacity ? self->m_operators_capacity * 2 : 16;
+        self->m_operators = counted_realloc(self->m_operators, sizeof(int) * self->m_operators_capacity);
+    }
+    self->m_operators[self->m_operators_length++] = operator;
+}
+
+// Pops the top operator and its two operands, and pushes them combined.
+static inline void reduce(Parser* self)
+{
+    BinaryOperationType type = self->m_operators[--self->m_operators_length];
+    AstRef right = self->m_operands[--self->m_operands_length];
+    AstRef left = self->m_operands[--self->m_operands_length];
+    push_operand(self, add_node(self, AST_KIND_BINARY_OPERATION, type, left, right));
+}
+
+AstRef parser_make_expression(Parser* self)
+{
+    size_t operators_base = self->m_operators_length;
+    size_t parentheses = 0;
+    while (true) {
+        while (parser_type(self) == TOKEN_TYPE_LPAREN) {
+            push_operator(self, PARENTHESIS_MARKER);
+            parentheses++;
+            parser_next(self);
+        }
+        push_operand(self, parser_make_value(self));
+
+        while (parentheses > 0 && parser_type(self) == TOKEN_TYPE_RPAREN) {
+            while (self->m_operators[self->m_operators_length - 1] != PARENTHESIS_MARKER)
+                reduce(self);
+            self->m_operators_length--;
+            parentheses--;
+            parser_next(self);
+        }
+
+        int operation = binary_operation_of(parser_type(self));
+        if (operation < 0)
+            break;
+        // reducing on equal precedence makes every operator left associative
+        while (self->m_operators_length > operators_base
+            && self->m_operators[self->m_operators_length - 1] != PARENTHESIS_MARKER
+            && precedence(self->m_operators[self->m_operators_length - 1]) >= precedence(operation))
+            reduce(self);
+        push_operator(self, operation);
         parser_next(self);
-        ExpressionNode* right = parser_make_addition(self);
-        return (ExpressionNode*) new_binary_operation_node(BINARY_OPERATION_TYPE_ADD, left, right);
     }
-    return left;
+    if (parentheses > 0)
+        parser_error(self, "unexpected token, expected ')'");
+    while (self->m_operators_length > operators_base)
+        reduce(self);
+    return self->m_operands[--self->m_operands_length];
 }
 
-ExpressionNode* parser_make_value(Parser* self)
+AstRef parser_make_value(Parser* self)
 {
-    if (self->t->type == TOKEN_TYPE_IDENTIFIER) {
-        Token* token = self->t;
+    if (parser_type(self) == TOKEN_TYPE_IDENTIFIER) {
+        Token token = parser_token(self);
         parser_next(self);
-        return (ExpressionNode*) new_symbol_node(token);
-    } else if (self->t->type == TOKEN_TYPE_INT_LITERAL) {
-        Token* token = self->t;
+        return add_token_node(self, AST_KIND_SYMBOL, token, AST_NONE, AST_NONE);
+    } else if (parser_type(self) == TOKEN_TYPE_INT_LITERAL) {
+        Token token = parser_token(self);
         parser_next(self);
-        return (ExpressionNode*) new_int_node(token);
+        return add_token_node(self, AST_KIND_INT, token, AST_NONE, AST_NONE);
     } else {
-        assert(!"unexpected token type");
+        parser_error(self, "unexpected token");
     }
 }
 
 void parser_skip_newline(Parser* self)
 {
-    while (self->t->type == TOKEN_TYPE_EOL)
+    while (parser_type(self) == TOKEN_TYPE_EOL)
         parser_next(self);
 }
 
 void check_and_skip_newline(Parser* self)
 {
-    if (self->t->type != TOKEN_TYPE_EOL)
-        assert(!"expected ';'");
+    if (parser_type(self) != TOKEN_TYPE_EOL)
+        parser_error(self, "expected ';'");
     parser_skip_newline(self);
 }
 
+void parser_error(Parser* self, const char* message)
+{
+    Token token = parser_token(self);
+    if (self->lines) {
+        SourcePosition position = line_index_position(self->lines, token.value - self->lexer->text);
+        fprintf(stderr, "%s:%zu:%zu: error: %s\n", self->path, position.line, position.column, message);
+    } else {
+        fprintf(stderr, "error: %s\n", message);
+    }
+    abort();
+}
+
 void parser_next(Parser* self)
 {
-    self->index++;
-    self->done = self->index >= self->tokens->length(self->tokens);
-    self->t = self->done ? NULL : self->tokens->get(self->tokens, self->index);
-    self->done = self->t->type == TOKEN_TYPE_EOF || self->done;
+    // the last token is EOF, and the parser stays on it
+    if (!self->done) {
+        lexer_next_token(self->lexer);
+        self->lookahead[self->head] = self->lexer->token;
+        self->head = (self->head + 1) & (PARSER_LOOKAHEAD - 1);
+    }
+    self->done = parser_type(self) == TOKEN_TYPE_EOF;
+}
+
+static void parse_with_positions(Ast* ast, const char* text, size_t length, const char* path, LineIndex* lines)
+{
+    assert(length <= UINT32_MAX && "source too large for 32 bit token offsets");
+    ast_reset(ast, text);
+    // generated and handwritten sources have a node every 2 to 6 bytes
+    ast_reserve(ast, length / 4 + 1);
+    Parser* parser = new_parser(ast, text, length);
+    parser->path = path;
+    parser->lines = lines;
+    ast->statements = parser_parse(parser);
+    delete_parser(parser);
+}
+
+void parse_into(Ast* ast, const char* text, size_t length)
+{
+    parse_with_positions(ast, text, length, NULL, NULL);
+}
+
+Ast* parse(const char* text, size_t length)
+{
+    Ast* ast = new_ast();
+    parse_into(ast, text, length);
+    return ast;
+}
+
+void parse_file_into(Ast* ast, MappedFile* source)
+{
+    parse_with_positions(ast, source->text, source->length, source->path, source->lines);
 }
 
-List* parse(List* tokens)
+Ast* parse_file(MappedFile* source)
 {
-    Parser* parser = new_parser(tokens);
-    List* ast = parser_parse(parser);
-    free(parser);
+    Ast* ast = new_ast();
+    parse_file_into(ast, source);
     return ast;
 }
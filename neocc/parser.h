@@ -1,7 +1,9 @@
 #pragma once
 
 #include "utils.h"
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum TokenType {
     TOKEN_TYPE_IDENTIFIER,
@@ -26,7 +28,24 @@ typedef enum TokenType {
     TOKEN_TYPE_COMMA,
     TOKEN_TYPE_ASSIGN,
     TOKEN_TYPE_EQUAL,
+    TOKEN_TYPE_NOT_EQUAL,
+    TOKEN_TYPE_NOT,
     TOKEN_TYPE_PLUS,
+    TOKEN_TYPE_MINUS,
+    TOKEN_TYPE_STAR,
+    TOKEN_TYPE_SLASH,
+    TOKEN_TYPE_PERCENT,
+    TOKEN_TYPE_LEFT_SHIFT,
+    TOKEN_TYPE_RIGHT_SHIFT,
+    TOKEN_TYPE_LESS,
+    TOKEN_TYPE_LESS_EQUAL,
+    TOKEN_TYPE_GREATER,
+    TOKEN_TYPE_GREATER_EQUAL,
+    TOKEN_TYPE_AMPERSAND,
+    TOKEN_TYPE_CARET,
+    TOKEN_TYPE_PIPE,
+    TOKEN_TYPE_AND,
+    TOKEN_TYPE_OR,
     TOKEN_TYPE_EOL,
     TOKEN_TYPE_EOF,
 } TokenType;
@@ -39,176 +58,84 @@ typedef struct Token {
     size_t length;
 } Token;
 
-Token* new_token(
-    const TokenType type,
-    const char* value,
-    const size_t length);
-void delete_token(Token* self);
 char* token_to_string(Token* self);
 
+// Tokens as parallel arrays, token i is the length[i] chars at
+// text + offsets[i]. Token structs are only made for what the AST keeps.
+typedef struct TokenBuffer {
+    const char* text;
+    size_t m_length;
+    size_t m_capacity;
+    uint8_t* types;
+    uint32_t* offsets;
+    uint32_t* lengths;
+} TokenBuffer;
+
+TokenBuffer* new_token_buffer(const char* text);
+void delete_token_buffer(TokenBuffer* self);
+size_t token_buffer_length(TokenBuffer* self);
+void token_buffer_reserve(TokenBuffer* self, size_t capacity);
+void token_buffer_add(TokenBuffer* self, TokenType type, uint32_t offset, uint32_t length);
+Token token_buffer_get(TokenBuffer* self, size_t index);
+
 typedef struct Lexer {
+    // the token lexed last by lexer_next_token
+    Token token;
     const char* text;
-    int index;
+    // text[length] is '\0', and length fits in 32 bits like token offsets
+    size_t length;
+    uint32_t index;
     char c;
     bool done;
+    // skips runs one char at a time instead of 16 at once
+    bool scalar;
 } Lexer;
 
-Lexer* new_lexer(char* text);
+Lexer* new_lexer(const char* text, size_t length);
 void delete_lexer(Lexer* self);
-List* lexer_tokenize(Lexer* self);
-Token* lexer_match_char(Lexer* self);
-Token* lexer_make_number(Lexer* self);
-Token* lexer_make_name(Lexer* self);
-Token* lexer_make_equal_or_assign(Lexer* self);
+TokenBuffer* lexer_tokenize(Lexer* self);
+// Lexes one token into self->token, and only EOF once the text is done.
+void lexer_next_token(Lexer* self);
+void lexer_match_char(Lexer* self);
+void lexer_make_number(Lexer* self);
+void lexer_make_name(Lexer* self);
+void lexer_make_equal_or_assign(Lexer* self);
+void lexer_make_operator(Lexer* self);
 void lexer_next(Lexer* self);
 
-List* tokenize(char* text);
-
-typedef struct Node {
-    void (*delete)(struct Node* self);
-    char* (*to_string)(struct Node* self);
-} Node;
-
-// Should only be used as passed deletor.
-void delete_node_inheriter(Node* self);
-
-typedef enum StatementNodeType {
-    STATEMENT_TYPE_FUNC_DEF,
-    STATEMENT_TYPE_RETURN,
-    STATEMENT_TYPE_DECLARATION,
-    STATEMENT_TYPE_EXPRESSION,
-} StatementNodeType;
-
-const char* statement_node_type_to_string(StatementNodeType type);
-
-typedef struct StatementNode {
-    void (*delete)(struct StatementNode* self);
-    char* (*to_string)(struct StatementNode* self);
-    StatementNodeType node_type;
-} StatementNode;
-
-typedef enum ExpressionNodeType {
-    EXPRESSION_TYPE_ASSIGNMENT,
-    EXPRESSION_TYPE_BINARY_OPERATION,
-    EXPRESSION_TYPE_SYMBOL,
-    EXPRESSION_TYPE_INT,
-} ExpressionNodeType;
-
-const char* expression_node_type_to_string(ExpressionNodeType type);
-
-typedef struct ExpressionNode {
-    void (*delete)(struct ExpressionNode* self);
-    char* (*to_string)(struct ExpressionNode* self);
-    ExpressionNodeType node_type;
-} ExpressionNode;
-
-typedef enum TypeNodeType {
-    TYPE_NODE_TYPE_KEYWORD,
-} TypeNodeType;
-
-const char* type_node_type_to_string(TypeNodeType type);
-
-typedef struct TypeNode {
-    void (*delete)(struct TypeNode* self);
-    char* (*to_string)(struct TypeNode* self);
-    TypeNodeType node_type;
-} TypeNode;
-
-typedef enum DeclarationNodeType {
-    DECLARATION_TYPE_DEFAULT,
-    DECLARATION_TYPE_INITIALIZATION,
-} DeclarationNodeType;
-
-const char* declaration_node_type_to_string(DeclarationNodeType type);
-
-typedef struct DeclarationNode {
-    void (*delete)(struct DeclarationNode* self);
-    char* (*to_string)(struct DeclarationNode* self);
-    DeclarationNodeType node_type;
-    TypeNode* value_type;
-    Token* target;
-} DeclarationNode;
-
-DeclarationNode* new_declaration_node(TypeNode* value_type, Token* target);
-void delete_declaration_node(DeclarationNode* self);
-char* declaration_node_to_string(DeclarationNode* self);
-
-char* declaration_nodes_to_string(List* declarations);
-
-typedef struct FuncDefNode {
-    void (*delete)(struct FuncDefNode* self);
-    char* (*to_string)(struct FuncDefNode* self);
-    StatementNodeType node_type;
-    Token* target;
-    TypeNode* return_type;
-    List* params;
-    List* body;
-} FuncDefNode;
-
-FuncDefNode* new_func_def_node(
-    Token* target,
-    TypeNode* return_type,
-    List* params,
-    List* body);
-void delete_func_def_node(FuncDefNode* self);
-char* func_def_node_to_string(FuncDefNode* self);
-
-typedef struct ReturnNode {
-    void (*delete)(struct ReturnNode* self);
-    char* (*to_string)(struct ReturnNode* self);
-    StatementNodeType node_type;
-    ExpressionNode* value;
-} ReturnNode;
-
-ReturnNode* new_return_node(ExpressionNode* value);
-void delete_return_node(ReturnNode* self);
-char* return_node_to_string(ReturnNode* self);
-
-typedef struct Initialization {
-    void (*delete)(struct Initialization* self);
-    char* (*to_string)(struct Initialization* self);
-    DeclarationNodeType node_type;
-    TypeNode* value_type;
-    Token* target;
-    ExpressionNode* value;
-} Initialization;
-
-Initialization* new_initialization_node(TypeNode* value_type, Token* target, ExpressionNode* value);
-void delete_initialization_node(Initialization* self);
-char* initialization_node_to_string(Initialization* self);
-
-typedef struct DeclStmtNode {
-    void (*delete)(struct DeclStmtNode* self);
-    char* (*to_string)(struct DeclStmtNode* self);
-    StatementNodeType node_type;
-    List* declarations;
-} DeclStmtNode;
-
-DeclStmtNode* new_declaration_statement_node(List* declarations);
-void delete_declaration_statement_node(DeclStmtNode* self);
-char* declaration_statement_node_to_string(DeclStmtNode* self);
-
-typedef struct ExprStmtNode {
-    void (*delete)(struct ExprStmtNode* self);
-    char* (*to_string)(struct ExprStmtNode* self);
-    StatementNodeType node_type;
-    ExpressionNode* value;
-} ExprStmtNode;
-
-ExprStmtNode* new_expression_statement_node(ExpressionNode* value);
-void delete_expression_statement_node(ExprStmtNode* self);
-char* expression_statement_to_string(ExprStmtNode* self);
-
-typedef struct KeywordTypeNode {
-    void (*delete)(struct KeywordTypeNode* self);
-    char* (*to_string)(struct KeywordTypeNode* self);
-    TypeNodeType node_type;
-    Token* token;
-} KeywordTypeNode;
-
-KeywordTypeNode* new_keyword_type_node(Token* token);
-void delete_keyword_type_node(KeywordTypeNode* self);
-char* keyword_type_node_to_string(KeywordTypeNode* self);
+TokenBuffer* tokenize(const char* text, size_t length);
+
+// Index of a node in its Ast, AST_NONE is no node.
+typedef uint32_t AstRef;
+
+#define AST_NONE 0
+
+typedef enum AstKind {
+    // offset and length cover the whole definition, from the return type
+    // to the '}', first is the DECLARATION of its name and return type,
+    // second the first statement of the body
+    AST_KIND_FUNC_DEF,
+    // first is the value
+    AST_KIND_RETURN,
+    // first is the first DECLARATION or INITIALIZATION
+    AST_KIND_DECLARATION_STATEMENT,
+    // first is the value
+    AST_KIND_EXPRESSION_STATEMENT,
+    // the token is the name, first is the type
+    AST_KIND_DECLARATION,
+    // the token is the name, first is the type and second the value
+    AST_KIND_INITIALIZATION,
+    // the token is the keyword
+    AST_KIND_KEYWORD_TYPE,
+    // the token is the target, first is the value
+    AST_KIND_ASSIGNMENT,
+    // first and second are the left and right operands
+    AST_KIND_BINARY_OPERATION,
+    AST_KIND_SYMBOL,
+    AST_KIND_INT,
+} AstKind;
+
+const char* ast_kind_to_string(AstKind kind);
 
 typedef enum AssignmentType {
     ASSIGNMENT_TYPE_DEFAULT,
@@ -216,82 +143,155 @@ typedef enum AssignmentType {
 
 const char* assignment_type_to_string(AssignmentType type);
 
-typedef struct AssignmentNode {
-    void (*delete)(struct AssignmentNode* self);
-    char* (*to_string)(struct AssignmentNode* self);
-    ExpressionNodeType node_type;
-    AssignmentType asignment_type;
-    Token* target;
-    ExpressionNode* value;
-} AssignmentNode;
-
-AssignmentNode* new_assignment_node(AssignmentType asignment_type, Token* target, ExpressionNode* value);
-void delete_assignment_node(AssignmentNode* self);
-char* assignment_node_to_string(AssignmentNode* self);
-
 typedef enum BinaryOperationType {
+    BINARY_OPERATION_TYPE_MULTIPLY,
+    BINARY_OPERATION_TYPE_DIVIDE,
+    BINARY_OPERATION_TYPE_MODULO,
     BINARY_OPERATION_TYPE_ADD,
+    BINARY_OPERATION_TYPE_SUBTRACT,
+    BINARY_OPERATION_TYPE_LEFT_SHIFT,
+    BINARY_OPERATION_TYPE_RIGHT_SHIFT,
+    BINARY_OPERATION_TYPE_LESS,
+    BINARY_OPERATION_TYPE_LESS_EQUAL,
+    BINARY_OPERATION_TYPE_GREATER,
+    BINARY_OPERATION_TYPE_GREATER_EQUAL,
+    BINARY_OPERATION_TYPE_EQUAL,
+    BINARY_OPERATION_TYPE_NOT_EQUAL,
+    BINARY_OPERATION_TYPE_BITWISE_AND,
+    BINARY_OPERATION_TYPE_BITWISE_XOR,
+    BINARY_OPERATION_TYPE_BITWISE_OR,
+    BINARY_OPERATION_TYPE_LOGICAL_AND,
+    BINARY_OPERATION_TYPE_LOGICAL_OR,
 } BinaryOperationType;
 
 const char* binary_operation_type_to_string(BinaryOperationType type);
 
-typedef struct BinaryOperationNode {
-    void (*delete)(struct BinaryOperationNode* self);
-    char* (*to_string)(struct BinaryOperationNode* self);
-    ExpressionNodeType node_type;
-    BinaryOperationType operation_type;
-    ExpressionNode* left;
-    ExpressionNode* right;
-} BinaryOperationNode;
-
-BinaryOperationNode* new_binary_operation_node(BinaryOperationType operation_type, ExpressionNode* left, ExpressionNode* right);
-void delete_binary_operation_node(BinaryOperationNode* self);
-char* binary_operation_to_string(BinaryOperationNode* self);
-
-typedef struct SymbolNode {
-    void (*delete)(struct SymbolNode* self);
-    char* (*to_string)(struct SymbolNode* self);
-    ExpressionNodeType node_type;
-    Token* token;
-} SymbolNode;
-
-SymbolNode* new_symbol_node(Token* token);
-void delete_symbol_node(SymbolNode* self);
-char* symbol_node_to_string(SymbolNode* self);
-
-typedef struct IntNode {
-    void (*delete)(struct IntNode* self);
-    char* (*to_string)(struct IntNode* self);
-    ExpressionNodeType node_type;
-    Token* token;
-} IntNode;
-
-IntNode* new_int_node(Token* token);
-void delete_int_node(IntNode* self);
-char* int_node_to_string(IntNode* self);
-
+// Every kind of node in one struct, what the fields mean depends on kind.
+typedef struct AstNode {
+    uint8_t kind;
+    // the TokenType of the token
+    uint8_t token_type;
+    // the BinaryOperationType or AssignmentType
+    uint8_t operation_type;
+    // the token is the length chars at offset in the text
+    uint32_t offset;
+    uint32_t length;
+    // the next node of the statements or declarations it is part of
+    AstRef next;
+    AstRef first;
+    AstRef second;
+} AstNode;
+
+// All nodes of one parse in a single array, children refer to each other
+// by index. Node 0 is unused so that AST_NONE is never a node.
+typedef struct Ast {
+    const char* text;
+    // the first top level statement
+    AstRef statements;
+    size_t m_length;
+    size_t m_capacity;
+    AstNode* nodes;
+    // set when nodes point into a read-only mapping instead of the heap
+    void* m_mapping;
+    size_t m_mapping_length;
+} Ast;
+
+Ast* new_ast();
+// The length nodes of an AstCache entry, used where they are mapped. The
+// Ast unmaps mapping when it is deleted or reset, and can't be added to.
+Ast* new_mapped_ast(const char* text, AstRef statements, const AstNode* nodes, size_t length, void* mapping,
+    size_t mapping_length);
+void delete_ast(Ast* self);
+// Drops every node but keeps their memory, the nodes added next point into
+// text.
+void ast_reset(Ast* self, const char* text);
+// The number of nodes, including node 0.
+size_t ast_length(Ast* self);
+// Makes room for capacity nodes, so that adding them does not move the others.
+void ast_reserve(Ast* self, size_t capacity);
+AstRef ast_add(Ast* self, AstNode node);
+// Only valid until the next ast_add.
+AstNode* ast_get(Ast* self, AstRef ref);
+Token ast_token(Ast* self, AstRef ref);
+char* ast_node_to_string(Ast* self, AstRef ref);
+
+// tokens the parser can look ahead, a power of two
+#define PARSER_LOOKAHEAD 4
+
+// Pulls tokens from the lexer as it goes, so only PARSER_LOOKAHEAD tokens
+// exist at a time.
 typedef struct Parser {
-    List* tokens;
-    int index;
-    Token* t;
+    Ast* ast;
+    Lexer* lexer;
+    // where syntax errors are reported, lines may be NULL
+    const char* path;
+    LineIndex* lines;
+    // ring buffer of upcoming tokens, the current one at head
+    Token lookahead[PARSER_LOOKAHEAD];
+    size_t head;
     bool done;
+    // operand and operator stacks of parser_make_expression, which parses
+    // without recursing
+    size_t m_operands_length;
+    size_t m_operands_capacity;
+    AstRef* m_operands;
+    size_t m_operators_length;
+    size_t m_operators_capacity;
+    int* m_operators;
 } Parser;
 
-Parser* new_parser(List* tokens);
+Parser* new_parser(Ast* ast, const char* text, size_t length);
 void delete_parser(Parser* self);
-List* parser_parse(Parser* self);
+// Returns the first top level statement.
+AstRef parser_parse(Parser* self);
 void parser_next(Parser* self);
-List* parser_make_statements(Parser* self);
-StatementNode* parser_make_statement(Parser* self);
-StatementNode* parser_make_declaration_definition_or_initialization(Parser* self);
-FuncDefNode* parser_resume_function_definition(Parser* self, Token* target, TypeNode* type);
-DeclStmtNode* parser_resume_declaration_statement(Parser* self, Token* target, TypeNode* type);
-TypeNode* parser_make_type(Parser* self);
-ReturnNode* parser_make_return(Parser* self);
-ExpressionNode* parser_make_expression(Parser* self);
-ExpressionNode* parser_make_addition(Parser* self);
-ExpressionNode* parser_make_value(Parser* self);
+// The token distance tokens after the current one.
+Token parser_peek(Parser* self, size_t distance);
+// Returns the first statement, the others follow through next.
+AstRef parser_make_statements(Parser* self);
+AstRef parser_make_statement(Parser* self);
+AstRef parser_make_declaration_definition_or_initialization(Parser* self);
+AstRef parser_resume_function_definition(Parser* self, Token target, AstRef type, const char* start);
+AstRef parser_resume_declaration_statement(Parser* self, Token target, AstRef type);
+AstRef parser_make_type(Parser* self);
+AstRef parser_make_return(Parser* self);
+// Precedence climbing over every C binary operator, left associative,
+// with explicit stacks instead of recursion so that the depth of an
+// expression doesn't depend on the C stack.
+AstRef parser_make_expression(Parser* self);
+AstRef parser_make_value(Parser* self);
 void parser_skip_newline(Parser* self);
+// Prints the path, line and column of the current token and aborts.
+_Noreturn void parser_error(Parser* self, const char* message);
 void check_and_skip_newline(Parser* self);
 
-List* parse(List* tokens);
+// Parses text[length] == '\0' into ast, replacing what it held, without
+// keeping the tokens around.
+void parse_into(Ast* ast, const char* text, size_t length);
+Ast* parse(const char* text, size_t length);
+// Like parse_into, with positions in syntax errors.
+void parse_file_into(Ast* ast, MappedFile* source);
+Ast* parse_file(MappedFile* source);
+
+// bump when AstNode or what the parser makes of a text changes, so older
+// cache entries are missed
+#define AST_CACHE_VERSION 1
+
+// Parsed ASTs in a directory on disk, one file per source text, keyed by a
+// hash of the text. An entry is a header followed by the nodes as they are
+// in memory, so it only works on the machine that wrote it.
+typedef struct AstCache {
+    char* directory;
+    atomic_size_t hits;
+    atomic_size_t misses;
+} AstCache;
+
+AstCache* new_ast_cache(const char* directory);
+void delete_ast_cache(AstCache* self);
+// Maps the entry for text without copying its nodes, or returns NULL when
+// there is no entry for it.
+Ast* ast_cache_load(AstCache* self, const char* text, size_t length);
+void ast_cache_store(AstCache* self, Ast* ast, size_t length);
+// Loads the AST of source from cache, or parses it and stores it there.
+// cache may be NULL.
+Ast* parse_file_cached(MappedFile* source, AstCache* cache);
@@ -0,0 +1,309 @@
+#include "assembly.h"
+#include <assert.h>
+#include <stdlib.h>
+
+static inline bool operand_mentions(Operand operand, Register reg)
+{
+    return (operand.type == OPERAND_TYPE_REGISTER || operand.type == OPERAND_TYPE_MEMORY) && operand.reg == reg;
+}
+
+static inline bool mentions(Instruction* instruction, Register reg)
+{
+    return operand_mentions(instruction->source, reg) || operand_mentions(instruction->destination, reg);
+}
+
+static inline bool is_register(Operand operand, Register reg)
+{
+    return operand.type == OPERAND_TYPE_REGISTER && operand.reg == reg;
+}
+
+static inline bool operand_equals(Operand a, Operand b)
+{
+    return a.type == b.type && a.reg == b.reg && a.value == b.value;
+}
+
+static inline bool fits_int32(int64_t value)
+{
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// Whether the value in reg after instruction index is never read on the
+// way to the next jump, which is assumed to read it. Falling through a
+// label keeps scanning, and ret reads the return value.
+static bool dead_after(Assembly* self, size_t index, Register reg)
+{
+    for (size_t i = index + 1; i < assembly_length(self); i++) {
+        Instruction* instruction = assembly_get(self, i);
+        switch (instruction->opcode) {
+        case OPCODE_MOV:
+            if (operand_mentions(instruction->source, reg)
+                || (instruction->destination.type == OPERAND_TYPE_MEMORY && instruction->destination.reg == reg))
+                return false;
+            // 32 bit moves zero the upper half, so both overwrite everything
+            if (is_register(instruction->destination, reg))
+                return true;
+            break;
+        case OPCODE_LABEL:
+            break;
+        case OPCODE_JMP:
+        case OPCODE_JNE:
+        case OPCODE_CALL:
+        case OPCODE_RET:
+        case OPCODE_INT:
+            return false;
+        case OPCODE_IDIV:
+        case OPCODE_CLTD:
+            // %eax and %edx are used without being operands
+            if (reg == REGISTER_RAX || reg == REGISTER_RDX || mentions(instruction, reg))
+                return false;
+            break;
+        default:
+            if (mentions(instruction, reg))
+                return false;
+            break;
+        }
+    }
+    return false;
+}
+
+// Leaf functions that spill nothing don't need %rbp, so the pushq %rbp,
+// movq %rsp, %rbp and popq %rbp around them can go.
+static void drop_frame(Assembly* self)
+{
+    size_t length = assembly_length(self);
+    if (length < 3 || assembly_get(self, 0)->opcode != OPCODE_LABEL)
+        return;
+    Instruction* push = assembly_get(self, 1);
+    Instruction* move = assembly_get(self, 2);
+    if (push->opcode != OPCODE_PUSH || !is_register(push->source, REGISTER_RBP) || move->opcode != OPCODE_MOV
+        || !is_register(move->source, REGISTER_RSP) || !is_register(move->destination, REGISTER_RBP))
+        return;
+    for (size_t i = 3; i < length; i++) {
+        Instruction* instruction = assembly_get(self, i);
+        if (instruction->opcode == OPCODE_CALL)
+            return;
+        if (instruction->opcode != OPCODE_POP && mentions(instruction, REGISTER_RBP))
+            return;
+    }
+
+    size_t write = 1;
+    for (size_t read = 3; read < length; read++) {
+        Instruction* instruction = assembly_get(self, read);
+        if (instruction->opcode == OPCODE_POP && is_register(instruction->source, REGISTER_RBP))
+            continue;
+        *assembly_get(self, write++) = *instruction;
+    }
+    assembly_truncate(self, write);
+}
+
+static bool is_foldable_operation(Opcode opcode)
+{
+    switch (opcode) {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_IMUL:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_SHL:
+    case OPCODE_SAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// movl X, %eax; opl Y, %eax; movl %eax, X becomes opl Y, X.
+static bool fold_operation(Assembly* self, size_t index, Instruction* result)
+{
+    if (index + 2 >= assembly_length(self))
+        return false;
+    Instruction* load = assembly_get(self, index);
+    Instruction* operation = assembly_get(self, index + 1);
+    Instruction* store = assembly_get(self, index + 2);
+    if (load->opcode != OPCODE_MOV || !is_register(load->destination, REGISTER_RAX)
+        || !is_foldable_operation(operation->opcode) || !is_register(operation->destination, REGISTER_RAX)
+        || store->opcode != OPCODE_MOV || !is_register(store->source, REGISTER_RAX)
+        || !operand_equals(load->source, store->destination) || load->size != operation->size
+        || operation->size != store->size)
+        return false;
+    Operand target = store->destination;
+    if (operand_mentions(operation->source, REGISTER_RAX) || operand_mentions(target, REGISTER_RAX))
+        return false;
+    if (target.type == OPERAND_TYPE_MEMORY
+        && (operation->source.type == OPERAND_TYPE_MEMORY || operation->opcode == OPCODE_IMUL))
+        return false;
+    if (target.type != OPERAND_TYPE_REGISTER && target.type != OPERAND_TYPE_MEMORY)
+        return false;
+    if (!dead_after(self, index + 2, REGISTER_RAX))
+        return false;
+    *result = (Instruction) {
+        .opcode = operation->opcode,
+        .size = operation->size,
+        .source = operation->source,
+        .destination = target,
+    };
+    return true;
+}
+
+static bool is_set(Opcode opcode)
+{
+    return opcode >= OPCODE_SETE && opcode <= OPCODE_SETGE;
+}
+
+// movl X, %eax; cmpl Y, %eax; setcc %al; movzbl %al, %eax compares X
+// directly, movzbl overwrites all of %eax anyway.
+static bool fold_comparison(Assembly* self, size_t index, Instruction* result)
+{
+    if (index + 3 >= assembly_length(self))
+        return false;
+    Instruction* load = assembly_get(self, index);
+    Instruction* compare = assembly_get(self, index + 1);
+    Instruction* set = assembly_get(self, index + 2);
+    Instruction* extend = assembly_get(self, index + 3);
+    if (load->opcode != OPCODE_MOV || !is_register(load->destination, REGISTER_RAX) || compare->opcode != OPCODE_CMP
+        || !is_register(compare->destination, REGISTER_RAX) || load->size != compare->size || !is_set(set->opcode)
+        || extend->opcode != OPCODE_MOVZB || !is_register(extend->destination, REGISTER_RAX))
+        return false;
+    Operand left = load->source;
+    if (operand_mentions(left, REGISTER_RAX) || operand_mentions(compare->source, REGISTER_RAX))
+        return false;
+    if (left.type != OPERAND_TYPE_REGISTER
+        && !(left.type == OPERAND_TYPE_MEMORY && compare->source.type != OPERAND_TYPE_MEMORY))
+        return false;
+    *result = *compare;
+    result->destination = left;
+    return true;
+}
+
+// movl X, %eax; movl %eax, Y becomes movl X, Y, and movzbl %al, %eax;
+// movl %eax, %reg becomes movzbl %al, %reg.
+static bool fold_move(Assembly* self, size_t index, Instruction* result)
+{
+    if (index + 1 >= assembly_length(self))
+        return false;
+    Instruction* first = assembly_get(self, index);
+    Instruction* second = assembly_get(self, index + 1);
+    if (second->opcode != OPCODE_MOV || !is_register(second->source, REGISTER_RAX)
+        || !is_register(first->destination, REGISTER_RAX) || operand_mentions(second->destination, REGISTER_RAX))
+        return false;
+    if (first->opcode == OPCODE_MOVZB) {
+        if (second->destination.type != OPERAND_TYPE_REGISTER || !dead_after(self, index + 1, REGISTER_RAX))
+            return false;
+        *result = *first;
+        result->destination = second->destination;
+        return true;
+    }
+    if (first->opcode != OPCODE_MOV || first->size != second->size || operand_mentions(first->source, REGISTER_RAX))
+        return false;
+    Operand source = first->source;
+    Operand destination = second->destination;
+    // x86 has no memory to memory move, and stores take 32 bit immediates
+    if (source.type == OPERAND_TYPE_MEMORY && destination.type == OPERAND_TYPE_MEMORY)
+        return false;
+    if (source.type == OPERAND_TYPE_IMMEDIATE && destination.type == OPERAND_TYPE_MEMORY && !fits_int32(source.value))
+        return false;
+    if (!dead_after(self, index + 1, REGISTER_RAX))
+        return false;
+    *result = *second;
+    result->source = source;
+    return true;
+}
+
+
+// Picks a shorter instruction with the same effect.
+static void shorten(Instruction* instruction, Instruction* next)
+{
+    if (instruction->opcode != OPCODE_MOV || instruction->source.type != OPERAND_TYPE_IMMEDIATE
+        || instruction->destination.type != OPERAND_TYPE_REGISTER)
+        return;
+    // xorl clobbers the flags, which only a set or jne right after a cmp reads
+    if (instruction->source.value == 0 && !(next && (is_set(next->opcode) || next->opcode == OPCODE_JNE))) {
+        *instruction = (Instruction) {
+            .opcode = OPCODE_XOR,
+            .size = 4,
+            .source = instruction->destination,
+            .destination = instruction->destination,
+        };
+        return;
+    }
+    // movl zero extends, and its immediate is 4 bytes shorter than movq's
+    if (instruction->size == 8 && instruction->source.value >= 0 && instruction->source.value <= UINT32_MAX)
+        instruction->size = 4;
+}
+
+void peephole(Assembly* self)
+{
+    drop_frame(self);
+
+    size_t length = assembly_length(self);
+    size_t labels_length = assembly_labels_length(self);
+    // where every label is placed, so jumps can look at their target, and
+    // how many jumps go there
+    size_t* positions = counted_calloc(labels_length + 1, sizeof(size_t));
+    size_t* references = counted_calloc(labels_length + 1, sizeof(size_t));
+    for (size_t i = 0; i < labels_length; i++)
+        positions[i] = SIZE_MAX;
+    for (size_t i = 0; i < length; i++) {
+        Instruction* instruction = assembly_get(self, i);
+        if (instruction->opcode == OPCODE_LABEL)
+            positions[instruction->source.value] = i;
+        else if (instruction->source.type == OPERAND_TYPE_LABEL)
+            references[instruction->source.value]++;
+    }
+
+    size_t write = 0;
+    // after a jmp or ret until a label something jumps to
+    bool unreachable = false;
+    for (size_t read = 0; read < length; read++) {
+        Instruction instruction = *assembly_get(self, read);
+        if (instruction.opcode == OPCODE_LABEL) {
+            // labels starting with . are local to the function, the others
+            // may be called from elsewhere
+            int label = instruction.source.value;
+            if (assembly_label_name(self, label)[0] == '.' && references[label] == 0)
+                continue;
+            unreachable = false;
+        }
+        if (unreachable)
+            continue;
+        if (fold_operation(self, read, &instruction)) {
+            read += 2;
+        } else if (fold_comparison(self, read, &instruction)) {
+            read += 1;
+        } else if (fold_move(self, read, &instruction)) {
+            read += 1;
+        } else if (instruction.opcode == OPCODE_MOV && instruction.source.type == OPERAND_TYPE_REGISTER
+            && operand_equals(instruction.source, instruction.destination)) {
+            continue;
+        } else if (instruction.opcode == OPCODE_JMP) {
+            // a jump to a label placed right after it falls through anyway
+            size_t next = read + 1;
+            bool falls_through = false;
+            for (; next < length && assembly_get(self, next)->opcode == OPCODE_LABEL; next++)
+                falls_through |= assembly_get(self, next)->source.value == instruction.source.value;
+            if (falls_through) {
+                references[instruction.source.value]--;
+                continue;
+            }
+            // a jump to a ret can return right away, targets behind read
+            // may be overwritten already
+            size_t target = positions[instruction.source.value];
+            if (target != SIZE_MAX && target > read) {
+                while (target < length && assembly_get(self, target)->opcode == OPCODE_LABEL)
+                    target++;
+                if (target < length && assembly_get(self, target)->opcode == OPCODE_RET) {
+                    references[instruction.source.value]--;
+                    instruction = *assembly_get(self, target);
+                }
+            }
+        }
+        shorten(&instruction, read + 1 < length ? assembly_get(self, read + 1) : NULL);
+        // the read side is never behind, so nothing unread is overwritten
+        *assembly_get(self, write++) = instruction;
+        unreachable = instruction.opcode == OPCODE_JMP || instruction.opcode == OPCODE_RET;
+    }
+    assembly_truncate(self, write);
+    free(references);
+    free(positions);
+}
@@ -0,0 +1,159 @@
+#include "assembly.h"
+#include "ir.h"
+#include <assert.h>
+#include <stdlib.h>
+
+// Linear scan register allocation (Poletto and Sarkar). Every virtual
+// register lives from the instruction defining it to its last use, and
+// when more are live than there are registers, the one ending last is
+// moved to a stack slot.
+
+typedef struct Interval {
+    int reg;
+    size_t start;
+    size_t end;
+} Interval;
+
+static int compare_interval_starts(const void* a, const void* b)
+{
+    const Interval* left = a;
+    const Interval* right = b;
+    return (left->start > right->start) - (left->start < right->start);
+}
+
+static inline void extend(Interval* interval, size_t position)
+{
+    if (position < interval->start)
+        interval->start = position;
+    if (position > interval->end)
+        interval->end = position;
+}
+
+// After phi lowering a virtual register may be assigned in several blocks,
+// so an interval spans every definition and use in block order.
+static Interval* compute_intervals(IrFunction* function, RegisterAllocation* allocation)
+{
+    Interval* intervals = counted_calloc(function->registers_length, sizeof(Interval));
+    for (int i = 0; i < function->registers_length; i++)
+        intervals[i] = (Interval) { .reg = i, .start = SIZE_MAX, .end = 0 };
+    size_t position = 0;
+    for (int i = 0; i < function->blocks->length(function->blocks); i++) {
+        IrBlock* block = ir_function_block(function, i);
+        for (size_t j = 0; !block->removed && j < ir_block_length(block); j++, position++) {
+            IrInstruction* instruction = ir_block_get(block, j);
+            int* use;
+            for (int k = 0; (use = ir_function_use(function, instruction, k)); k++)
+                extend(&intervals[*use], position);
+            switch (instruction->opcode) {
+            case IR_OPCODE_CONST:
+                allocation->locations[instruction->destination] = operand_immediate(instruction->value);
+                break;
+            case IR_OPCODE_COPY:
+            case IR_OPCODE_ADD:
+            case IR_OPCODE_SUB:
+            case IR_OPCODE_MUL:
+            case IR_OPCODE_DIV:
+            case IR_OPCODE_MOD:
+            case IR_OPCODE_SHL:
+            case IR_OPCODE_SHR:
+            case IR_OPCODE_AND:
+            case IR_OPCODE_OR:
+            case IR_OPCODE_XOR:
+            case IR_OPCODE_EQ:
+            case IR_OPCODE_NE:
+            case IR_OPCODE_LT:
+            case IR_OPCODE_LE:
+            case IR_OPCODE_GT:
+            case IR_OPCODE_GE:
+            case IR_OPCODE_PHI:
+                extend(&intervals[instruction->destination], position);
+                break;
+            case IR_OPCODE_NOP:
+            case IR_OPCODE_JUMP:
+            case IR_OPCODE_BRANCH:
+            case IR_OPCODE_RETURN:
+                break;
+            }
+        }
+    }
+    // constants are used as immediates and don't need a register
+    for (int i = 0; i < function->registers_length; i++)
+        if (allocation->locations[i].type == OPERAND_TYPE_IMMEDIATE)
+            intervals[i].start = SIZE_MAX;
+    return intervals;
+}
+
+static Operand spill_slot(RegisterAllocation* allocation)
+{
+    allocation->spill_slots++;
+    return operand_memory(REGISTER_RBP, -8 * allocation->spill_slots);
+}
+
+RegisterAllocation* allocate_registers(IrFunction* function, const Register* available, int available_length)
+{
+    RegisterAllocation* self = counted_calloc(1, sizeof(RegisterAllocation));
+    *self = (RegisterAllocation) {
+        .locations = counted_calloc(function->registers_length, sizeof(Operand)),
+        .locations_length = function->registers_length,
+        .spill_slots = 0,
+    };
+
+    Interval* intervals = compute_intervals(function, self);
+    qsort(intervals, function->registers_length, sizeof(Interval), compare_interval_starts);
+
+    Register* free_registers = counted_calloc(available_length + 1, sizeof(Register));
+    int free_length = 0;
+    for (int i = available_length - 1; i >= 0; i--)
+        free_registers[free_length++] = available[i];
+
+    // live intervals holding a register, ordered by increasing end
+    Interval** active = counted_calloc(available_length + 1, sizeof(Interval*));
+    int active_length = 0;
+
+    for (int i = 0; i < function->registers_length; i++) {
+        Interval* current = &intervals[i];
+        if (current->start == SIZE_MAX)
+            continue;
+
+        // intervals ending here give their register back, so a result can
+        // reuse the register of an operand it consumes
+        int expired = 0;
+        while (expired < active_length && active[expired]->end <= current->start) {
+            free_registers[free_length++] = self->locations[active[expired]->reg].reg;
+            expired++;
+        }
+        for (int j = expired; j < active_length; j++)
+            active[j - expired] = active[j];
+        active_length -= expired;
+
+        if (free_length > 0) {
+            self->locations[current->reg] = operand_register(free_registers[--free_length]);
+        } else if (active_length > 0 && active[active_length - 1]->end > current->end) {
+            Interval* spilled = active[--active_length];
+            self->locations[current->reg] = self->locations[spilled->reg];
+            self->locations[spilled->reg] = spill_slot(self);
+        } else {
+            self->locations[current->reg] = spill_slot(self);
+            continue;
+        }
+
+        int position = active_length;
+        while (position > 0 && active[position - 1]->end > current->end) {
+            active[position] = active[position - 1];
+            position--;
+        }
+        active[position] = current;
+        active_length++;
+    }
+
+    free(active);
+    free(free_registers);
+    free(intervals);
+    return self;
+}
+
+void delete_register_allocation(RegisterAllocation* self)
+{
+    free(self->locations);
+    free(self);
+}
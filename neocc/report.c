@@ -0,0 +1,129 @@
+#include "utils.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static atomic_size_t allocations = 0;
+static atomic_size_t allocated_bytes = 0;
+
+static inline void count_allocation(size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocated_bytes, size, memory_order_relaxed);
+}
+
+void* counted_malloc(size_t size)
+{
+    count_allocation(size);
+    return malloc(size);
+}
+
+void* counted_calloc(size_t amount, size_t size)
+{
+    count_allocation(amount * size);
+    return calloc(amount, size);
+}
+
+void* counted_realloc(void* pointer, size_t size)
+{
+    count_allocation(size);
+    return realloc(pointer, size);
+}
+
+AllocationCounts allocation_counts()
+{
+    return (AllocationCounts) {
+        .allocations = atomic_load_explicit(&allocations, memory_order_relaxed),
+        .bytes = atomic_load_explicit(&allocated_bytes, memory_order_relaxed),
+    };
+}
+
+static double seconds_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+static long peak_rss(int who)
+{
+    struct rusage usage;
+    getrusage(who, &usage);
+    return usage.ru_maxrss;
+}
+
+TimeReport* new_time_report()
+{
+    static_assert(sizeof(TimeReportPhase) == 48, "incomplete construction of TimeReportPhase");
+    static_assert(sizeof(TimeReport) == 48 * TIME_REPORT_MAX_PHASES + 32, "incomplete construction of TimeReport");
+    TimeReport* self = counted_calloc(1, sizeof(TimeReport));
+    *self = (TimeReport) {
+        .phases = { { 0 } },
+        .phases_length = 0,
+        .m_start = 0,
+        .m_start_counts = { 0 },
+    };
+    return self;
+}
+
+void delete_time_report(TimeReport* self)
+{
+    free(self);
+}
+
+void time_report_begin(TimeReport* self, const char* name)
+{
+    assert(self->phases_length < TIME_REPORT_MAX_PHASES && "too many phases in time report");
+    self->phases[self->phases_length] = (TimeReportPhase) { .name = name };
+    self->m_start_counts = allocation_counts();
+    self->m_start = seconds_now();
+}
+
+void time_report_end(TimeReport* self)
+{
+    double end = seconds_now();
+    AllocationCounts counts = allocation_counts();
+    TimeReportPhase* phase = &self->phases[self->phases_length++];
+    phase->seconds = end - self->m_start;
+    phase->peak_rss = peak_rss(RUSAGE_SELF);
+    phase->children_peak_rss = peak_rss(RUSAGE_CHILDREN);
+    phase->counts = (AllocationCounts) {
+        .allocations = counts.allocations - self->m_start_counts.allocations,
+        .bytes = counts.bytes - self->m_start_counts.bytes,
+    };
+}
+
+void time_report_print(TimeReport* self, FILE* fp)
+{
+    fprintf(fp, "%-12s %12s %14s %14s %12s %14s\n", "phase", "wall ms", "peak rss KiB", "child rss KiB", "allocations",
+        "bytes");
+    double total = 0;
+    for (size_t i = 0; i < self->phases_length; i++) {
+        TimeReportPhase* phase = &self->phases[i];
+        fprintf(fp, "%-12s %12.3f %14ld %14ld %12zu %14zu\n", phase->name, phase->seconds * 1e3, phase->peak_rss,
+            phase->children_peak_rss, phase->counts.allocations, phase->counts.bytes);
+        total += phase->seconds;
+    }
+    fprintf(fp, "%-12s %12.3f\n", "total", total * 1e3);
+}
+
+char* time_report_to_json(TimeReport* self)
+{
+    StringBuilder* json = new_string_builder();
+    string_builder_write(json, "{\"phases\": [");
+    for (size_t i = 0; i < self->phases_length; i++) {
+        TimeReportPhase* phase = &self->phases[i];
+        string_builder_write_fmt(json,
+            "%s\n  {\"name\": \"%s\", \"wall_seconds\": %.9f, \"peak_rss_kib\": %ld, \"children_peak_rss_kib\": %ld, "
+            "\"allocations\": %zu, \"allocated_bytes\": %zu}",
+            i == 0 ? "" : ",", phase->name, phase->seconds, phase->peak_rss, phase->children_peak_rss,
+            phase->counts.allocations, phase->counts.bytes);
+    }
+    string_builder_write(json, "\n]}\n");
+    char* result = string_builder_take(json);
+    delete_string_builder(json);
+    return result;
+}
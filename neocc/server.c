@@ -0,0 +1,254 @@
+#define _GNU_SOURCE
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef struct Server {
+    int listener;
+    int jobs;
+    FunctionCache* cache;
+    // connections still being served, serve waits for them before returning
+    size_t connections;
+    pthread_mutex_t lock;
+    pthread_cond_t connection_closed;
+} Server;
+
+typedef struct ServerConnection {
+    Server* server;
+    int fd;
+} ServerConnection;
+
+static bool read_exactly(int fd, void* buffer, size_t length)
+{
+    for (size_t done = 0; done < length;) {
+        ssize_t result = read(fd, (char*) buffer + done, length - done);
+        if (result <= 0)
+            return false;
+        done += result;
+    }
+    return true;
+}
+
+static bool write_exactly(int fd, const void* buffer, size_t length)
+{
+    for (size_t done = 0; done < length;) {
+        // a client hanging up early must not kill the server with SIGPIPE
+        ssize_t result = send(fd, (const char*) buffer + done, length - done, MSG_NOSIGNAL);
+        if (result <= 0)
+            return false;
+        done += result;
+    }
+    return true;
+}
+
+static bool write_response(int fd, ServerStatus status, const char* output, size_t length)
+{
+    ServerResponse response = { .status = status, .reserved = 0, .length = length };
+    return write_exactly(fd, &response, sizeof(response)) && write_exactly(fd, output, length);
+}
+
+// what a compiling child exits with after it could not write the response
+#define SERVER_CHILD_WRITE_FAILED 2
+
+static void compile_request(Server* server, int fd, ServerRequestKind kind, const char* source, size_t length)
+{
+    Ast* ast = parse(source, length);
+    List* functions = lower_cached(ast, server->jobs, server->cache);
+    optimize(functions, server->jobs);
+    StringBuilder* output = new_string_builder();
+    if (kind == SERVER_REQUEST_EXECUTABLE) {
+        compile_to_executable_bytes(functions, server->jobs, output);
+    } else {
+        char* assembly = compile(functions, server->jobs);
+        string_builder_write(output, assembly);
+        free(assembly);
+    }
+    bool written = write_response(fd, SERVER_STATUS_OK, string_builder_buffer(output), string_builder_length(output));
+    _exit(written ? 0 : SERVER_CHILD_WRITE_FAILED);
+}
+
+// Compiles in a child process, so that a source the compiler aborts on
+// only fails its own request. The child answers on fd itself, and what it
+// printed to stderr before dying becomes the error response. Returns
+// whether the connection can be used for more requests.
+static bool serve_request(Server* server, int fd, ServerRequestKind kind, const char* source, size_t length)
+{
+    assert(fd > STDERR_FILENO && "connection uses a standard stream");
+    int errors[2];
+    int error = pipe2(errors, O_CLOEXEC);
+    assert(error == 0 && "could not create pipe");
+    pid_t child = fork();
+    assert(child >= 0 && "could not fork");
+    if (child == 0) {
+        dup2(errors[1], STDERR_FILENO);
+        // The child inherits the connections and pipes of every other
+        // thread. A pipe end kept open would hold back the end of file its
+        // request waits for, so only fd and the standard streams stay.
+        close_range(STDERR_FILENO + 1, fd - 1, 0);
+        close_range(fd + 1, ~0U, 0);
+        compile_request(server, fd, kind, source, length);
+    }
+    close(errors[1]);
+    // read before waiting, the child blocks once the pipe is full
+    StringBuilder* diagnostics = new_string_builder();
+    char buffer[4096];
+    ssize_t read_length;
+    while ((read_length = read(errors[0], buffer, sizeof(buffer))) > 0)
+        string_builder_write_n(diagnostics, buffer, read_length);
+    close(errors[0]);
+    int status;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    bool usable = true;
+    if (WIFEXITED(status) && WEXITSTATUS(status) == SERVER_CHILD_WRITE_FAILED) {
+        usable = false;
+    } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (string_builder_length(diagnostics) == 0)
+            string_builder_write(diagnostics, "error: compiler failed\n");
+        usable = write_response(fd, SERVER_STATUS_ERROR, string_builder_buffer(diagnostics),
+            string_builder_length(diagnostics));
+    }
+    delete_string_builder(diagnostics);
+    return usable;
+}
+
+// The source buffer lives as long as the connection, so later requests
+// reuse the memory of earlier ones.
+static void* serve_connection(void* context)
+{
+    ServerConnection* connection = context;
+    Server* server = connection->server;
+    char* source = NULL;
+    size_t source_capacity = 0;
+
+    ServerRequest request;
+    while (read_exactly(connection->fd, &request, sizeof(request))) {
+        if (request.kind == SERVER_REQUEST_SHUTDOWN) {
+            // wakes the accept in serve
+            shutdown(server->listener, SHUT_RDWR);
+            break;
+        }
+        // checked before the length is used, a client can send anything
+        if (request.length > SERVER_MAX_SOURCE_LENGTH)
+            break;
+        if (request.length + 1 > source_capacity) {
+            source_capacity = request.length + 1;
+            source = counted_realloc(source, source_capacity);
+            assert(source && "could not allocate source buffer");
+        }
+        if (!read_exactly(connection->fd, source, request.length))
+            break;
+        source[request.length] = '\0';
+
+        if (request.kind != SERVER_REQUEST_EXECUTABLE && request.kind != SERVER_REQUEST_ASSEMBLY) {
+            const char* message = "error: unknown server request\n";
+            if (!write_response(connection->fd, SERVER_STATUS_ERROR, message, strlen(message)))
+                break;
+            continue;
+        }
+        if (!serve_request(server, connection->fd, request.kind, source, request.length))
+            break;
+    }
+
+    free(source);
+    close(connection->fd);
+    free(connection);
+
+    pthread_mutex_lock(&server->lock);
+    server->connections--;
+    pthread_cond_signal(&server->connection_closed);
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+static struct sockaddr_un socket_address(const char* socket_path)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    assert(strlen(socket_path) < sizeof(address.sun_path) && "socket path is too long");
+    strcpy(address.sun_path, socket_path);
+    return address;
+}
+
+void serve(const char* socket_path, int jobs, FunctionCache* cache)
+{
+    static_assert(sizeof(ServerRequest) == 16, "incomplete construction of ServerRequest");
+    static_assert(sizeof(ServerResponse) == 16, "incomplete construction of ServerResponse");
+    struct sockaddr_un address = socket_address(socket_path);
+    Server server = {
+        .listener = socket(AF_UNIX, SOCK_STREAM, 0),
+        .jobs = jobs,
+        .cache = cache,
+        .connections = 0,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .connection_closed = PTHREAD_COND_INITIALIZER,
+    };
+    assert(server.listener >= 0 && "could not create socket");
+    // a socket left behind by an earlier server would make bind fail
+    unlink(socket_path);
+    int error = bind(server.listener, (struct sockaddr*) &address, sizeof(address));
+    assert(error == 0 && "could not bind socket");
+    error = listen(server.listener, SOMAXCONN);
+    assert(error == 0 && "could not listen on socket");
+
+    int fd;
+    while ((fd = accept(server.listener, NULL, NULL)) >= 0) {
+        ServerConnection* connection = counted_calloc(1, sizeof(ServerConnection));
+        *connection = (ServerConnection) { .server = &server, .fd = fd };
+        pthread_mutex_lock(&server.lock);
+        server.connections++;
+        pthread_mutex_unlock(&server.lock);
+        pthread_t thread;
+        error = pthread_create(&thread, NULL, serve_connection, connection);
+        assert(error == 0 && "could not start connection thread");
+        pthread_detach(thread);
+    }
+
+    pthread_mutex_lock(&server.lock);
+    while (server.connections > 0)
+        pthread_cond_wait(&server.connection_closed, &server.lock);
+    pthread_mutex_unlock(&server.lock);
+    close(server.listener);
+    unlink(socket_path);
+}
+
+int server_connect(const char* socket_path)
+{
+    struct sockaddr_un address = socket_address(socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(fd >= 0 && "could not create socket");
+    int error = connect(fd, (struct sockaddr*) &address, sizeof(address));
+    assert(error == 0 && "could not connect to server");
+    return fd;
+}
+
+char* server_request(int connection, ServerRequestKind kind, const char* source, size_t source_length, size_t* length,
+    ServerStatus* status)
+{
+    ServerRequest request = { .kind = kind, .reserved = 0, .length = source_length };
+    bool sent = write_exactly(connection, &request, sizeof(request)) && write_exactly(connection, source, source_length);
+    assert(sent && "could not send request to server");
+    if (kind == SERVER_REQUEST_SHUTDOWN)
+        return NULL;
+
+    ServerResponse response;
+    bool received = read_exactly(connection, &response, sizeof(response));
+    assert(received && "server closed the connection");
+    char* result = counted_malloc(response.length + 1);
+    received = read_exactly(connection, result, response.length);
+    assert(received && "server closed the connection");
+    result[response.length] = '\0';
+    *length = response.length;
+    *status = response.status;
+    return result;
+}
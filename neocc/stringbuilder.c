@@ -5,13 +5,16 @@
 #include <string.h>
 #include <stdarg.h>
 
+#define STRING_BUILDER_MIN_CAPACITY 64
+
 StringBuilder* new_string_builder()
 {
-    static_assert(sizeof(StringBuilder) == 16, "incomplete construction of StringBuilder");
-    StringBuilder* self = calloc(1, sizeof(StringBuilder));
+    static_assert(sizeof(StringBuilder) == 24, "incomplete construction of StringBuilder");
+    StringBuilder* self = counted_calloc(1, sizeof(StringBuilder));
     *self = (StringBuilder) {
         .m_length = 0,
-        .m_buffer = calloc(1, sizeof(char)),
+        .m_capacity = 0,
+        .m_buffer = NULL,
     };
     return self;
 }
@@ -29,30 +32,86 @@ size_t string_builder_length(StringBuilder* self)
 
 char* string_builder_c_string(StringBuilder* self)
 {
-    char* buffer = calloc(1, self->m_length * sizeof(char) + 1);
-    memcpy(buffer, self->m_buffer, self->m_length);
+    char* buffer = counted_calloc(1, self->m_length * sizeof(char) + 1);
+    if (self->m_buffer)
+        memcpy(buffer, self->m_buffer, self->m_length);
     return buffer;
 }
 
 char* string_builder_buffer(StringBuilder* self)
 {
-    return self->m_buffer;
+    return self->m_buffer ? self->m_buffer : "";
+}
+
+char* string_builder_take(StringBuilder* self)
+{
+    char* buffer = self->m_buffer ? self->m_buffer : counted_calloc(1, sizeof(char));
+    self->m_length = 0;
+    self->m_capacity = 0;
+    self->m_buffer = NULL;
+    return buffer;
+}
+
+void string_builder_clear(StringBuilder* self)
+{
+    self->m_length = 0;
+    if (self->m_buffer)
+        self->m_buffer[0] = '\0';
 }
 
-void string_builder_write(StringBuilder* self, char* string)
+void string_builder_reserve(StringBuilder* self, size_t additional)
 {
-    size_t old_length = self->m_length;
-    self->m_length += strlen(string);
-    self->m_buffer = realloc(self->m_buffer, self->m_length * sizeof(char) + 1);
-    memset(self->m_buffer + sizeof(char) * old_length, '\0', self->m_length - old_length);
-    strcat(self->m_buffer, string);
+    // capacity excludes the null terminator
+    size_t required = self->m_length + additional;
+    if (required <= self->m_capacity)
+        return;
+    size_t capacity = self->m_capacity ? self->m_capacity : STRING_BUILDER_MIN_CAPACITY;
+    while (capacity < required)
+        capacity *= 2;
+    self->m_buffer = counted_realloc(self->m_buffer, capacity * sizeof(char) + 1);
+    assert(self->m_buffer && "could not allocate string builder");
+    self->m_capacity = capacity;
+}
+
+void string_builder_write_n(StringBuilder* self, const char* chars, size_t amount)
+{
+    string_builder_reserve(self, amount);
+    memcpy(self->m_buffer + self->m_length, chars, amount);
+    self->m_length += amount;
+    self->m_buffer[self->m_length] = '\0';
+}
+
+void string_builder_write(StringBuilder* self, const char* string)
+{
+    string_builder_write_n(self, string, strlen(string));
+}
+
+void string_builder_write_char(StringBuilder* self, char c)
+{
+    string_builder_reserve(self, 1);
+    self->m_buffer[self->m_length++] = c;
+    self->m_buffer[self->m_length] = '\0';
 }
 
 void string_builder_write_fmt(StringBuilder* self, const char* fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
-    char buffer[8192] = "";
-    vsnprintf(buffer, 8192, fmt, args);
-    string_builder_write(self, buffer);
+    va_list retry_args;
+    va_copy(retry_args, args);
+
+    // format straight into the spare capacity, and only if that doesn't
+    // fit, grow to the reported size and format again
+    string_builder_reserve(self, STRING_BUILDER_MIN_CAPACITY);
+    size_t available = self->m_capacity - self->m_length + 1;
+    int length = vsnprintf(self->m_buffer + self->m_length, available, fmt, args);
+    assert(length >= 0 && "invalid format string");
+    if ((size_t) length >= available) {
+        string_builder_reserve(self, length);
+        vsnprintf(self->m_buffer + self->m_length, length + 1, fmt, retry_args);
+    }
+    self->m_length += length;
+
+    va_end(retry_args);
+    va_end(args);
 }
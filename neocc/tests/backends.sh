@@ -0,0 +1,46 @@
+#!/bin/sh
+# Builds every program in examples/ with as and ld and with --direct, runs
+# it with --run, and fails unless all three exit with the same code, and
+# with the code of the program built by cc, when there is a cc. Examples
+# neocc can't compile yet are skipped.
+
+neocc="$(realpath ./neocc)"
+directory="$(mktemp -d /tmp/neocc-test-XXXXXX)"
+trap 'rm -rf "$directory"' EXIT
+failed=0
+
+# neocc writes temp.s and temp.o to the working directory
+compile() {
+    (cd "$directory" && exec "$neocc" "$@") > /dev/null 2>&1
+}
+
+for example in examples/*.c; do
+    source="$(realpath "$example")"
+    if ! compile "$source" -o assembled 2> /dev/null; then
+        echo "skip $example: neocc can't compile it"
+        continue
+    fi
+    "$directory/assembled"
+    assembled=$?
+    if ! compile --direct "$source" -o direct 2> /dev/null; then
+        echo "FAIL $example: --direct can't compile it"
+        failed=1
+        continue
+    fi
+    "$directory/direct"
+    direct=$?
+    "$neocc" --run "$source"
+    run=$?
+    expected=$assembled
+    if command -v cc > /dev/null && cc -w -o "$directory/reference" "$source" 2> /dev/null; then
+        "$directory/reference"
+        expected=$?
+    fi
+    if [ "$assembled" -ne "$expected" ] || [ "$assembled" -ne "$direct" ] || [ "$assembled" -ne "$run" ]; then
+        echo "FAIL $example: cc $expected, as/ld $assembled, --direct $direct, --run $run"
+        failed=1
+    else
+        echo "ok   $example: $assembled"
+    fi
+done
+exit $failed
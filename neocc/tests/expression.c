@@ -0,0 +1,146 @@
+#include "compiler.h"
+#include "parser.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parses, lowers and compiles one expression of a million terms mixing every
+// binary operator on the default stack, which overflows when any of them
+// recurses per term, and checks the tree is built left associative with C
+// precedence.
+
+#define TERMS 1000000
+
+static const char* operators[] = {
+    "+", "-", "*", "+", "^", "|", "&", "+", "<<", ">>", "==", "!=", "<", ">=", "&&", "||", "/", "%",
+};
+
+static char* generate_expression_program(size_t terms)
+{
+    size_t operators_length = sizeof(operators) / sizeof(operators[0]);
+    StringBuilder* text = new_string_builder();
+    string_builder_write(text, "int main()\n{\n    int a = 3;\n    int value = a");
+    for (size_t i = 1; i < terms; i++) {
+        const char* operator = operators[i % operators_length];
+        // divisors and shift counts stay small and non-zero
+        bool small = operator[0] == '/' || operator[0] == '%' || operator[1] == '<' || operator[1] == '>';
+        string_builder_write_fmt(text, i % 8 == 0 ? "\n        %s %zu" : " %s %zu", operator, small ? 1 + i % 3 : i % 100);
+    }
+    string_builder_write(text, ";\n    return value & 255;\n}\n");
+    char* result = string_builder_take(text);
+    delete_string_builder(text);
+    return result;
+}
+
+// Higher binds tighter, as in C. BinaryOperationType lists the operators
+// from the tightest binding group to the loosest.
+static int precedence(BinaryOperationType type)
+{
+    switch (type) {
+    case BINARY_OPERATION_TYPE_MULTIPLY:
+    case BINARY_OPERATION_TYPE_DIVIDE:
+    case BINARY_OPERATION_TYPE_MODULO:
+        return 10;
+    case BINARY_OPERATION_TYPE_ADD:
+    case BINARY_OPERATION_TYPE_SUBTRACT:
+        return 9;
+    case BINARY_OPERATION_TYPE_LEFT_SHIFT:
+    case BINARY_OPERATION_TYPE_RIGHT_SHIFT:
+        return 8;
+    case BINARY_OPERATION_TYPE_LESS:
+    case BINARY_OPERATION_TYPE_LESS_EQUAL:
+    case BINARY_OPERATION_TYPE_GREATER:
+    case BINARY_OPERATION_TYPE_GREATER_EQUAL:
+        return 7;
+    case BINARY_OPERATION_TYPE_EQUAL:
+    case BINARY_OPERATION_TYPE_NOT_EQUAL:
+        return 6;
+    case BINARY_OPERATION_TYPE_BITWISE_AND:
+        return 5;
+    case BINARY_OPERATION_TYPE_BITWISE_XOR:
+        return 4;
+    case BINARY_OPERATION_TYPE_BITWISE_OR:
+        return 3;
+    case BINARY_OPERATION_TYPE_LOGICAL_AND:
+        return 2;
+    case BINARY_OPERATION_TYPE_LOGICAL_OR:
+        return 1;
+    }
+    return 0;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char* message)
+{
+    if (!condition) {
+        fprintf(stderr, "FAIL tests/expression: %s\n", message);
+        failures++;
+    }
+}
+
+static bool is_binary_operation(Ast* ast, AstRef ref)
+{
+    return ast_get(ast, ref)->kind == AST_KIND_BINARY_OPERATION;
+}
+
+int main()
+{
+    char* text = generate_expression_program(TERMS);
+    Ast* ast = parse(text, strlen(text));
+
+    AstRef body = ast_get(ast, ast->statements)->second;
+    AstRef statement = ast_get(ast, body)->next;
+    AstRef initialization = ast_get(ast, statement)->first;
+    AstRef root = ast_get(ast, initialization)->second;
+    check(is_binary_operation(ast, root), "the root isn't a binary operation");
+    check(ast_get(ast, root)->operation_type == BINARY_OPERATION_TYPE_LOGICAL_OR, "the root isn't the last ||");
+
+    // Left associative: every operand on the right binds strictly tighter
+    // than its operator, and every one on the left at least as tight, so
+    // every || is on the left spine.
+    size_t logical_ors = 0;
+    size_t spine_logical_ors = 0;
+    size_t terms = 0;
+    size_t pending_length = 0;
+    AstRef* pending = counted_malloc(TERMS * sizeof(AstRef));
+    pending[pending_length++] = root;
+    while (pending_length > 0) {
+        AstRef ref = pending[--pending_length];
+        AstNode* node = ast_get(ast, ref);
+        if (node->kind != AST_KIND_BINARY_OPERATION) {
+            terms++;
+            continue;
+        }
+        if (node->operation_type == BINARY_OPERATION_TYPE_LOGICAL_OR)
+            logical_ors++;
+        int operation = precedence(node->operation_type);
+        if (is_binary_operation(ast, node->first))
+            check(precedence(ast_get(ast, node->first)->operation_type) >= operation, "a left operand binds looser than its operator");
+        if (is_binary_operation(ast, node->second))
+            check(precedence(ast_get(ast, node->second)->operation_type) > operation, "a right operand doesn't bind tighter than its operator");
+        pending[pending_length++] = node->first;
+        pending[pending_length++] = node->second;
+    }
+    for (AstRef ref = root; is_binary_operation(ast, ref); ref = ast_get(ast, ref)->first)
+        spine_logical_ors += ast_get(ast, ref)->operation_type == BINARY_OPERATION_TYPE_LOGICAL_OR;
+    check(terms == TERMS, "the expression doesn't have every term");
+    check(logical_ors == TERMS / (sizeof(operators) / sizeof(operators[0])), "the expression doesn't have every ||");
+    check(spine_logical_ors == logical_ors, "a || isn't on the left spine");
+    free(pending);
+
+    List* functions = lower(ast, 1);
+    optimize(functions, 1);
+    char* assembly = compile(functions, 1);
+    check(strstr(assembly, "main:") != NULL, "main wasn't compiled");
+
+    free(assembly);
+    list_delete_all_and_self(functions, (void (*)(void*)) delete_ir_function);
+    delete_ast(ast);
+    free(text);
+    if (failures > 0)
+        return 1;
+    printf("ok   tests/expression: %d terms\n", TERMS);
+    return 0;
+}
@@ -22,7 +22,7 @@ void println_and_free(char* string)
 
 char* chars_to_string(const char* chars, size_t amount)
 {
-    char* buffer = calloc(amount + 1, sizeof(char));
+    char* buffer = counted_calloc(amount + 1, sizeof(char));
     strncpy(buffer, chars, amount);
     return buffer;
 }
@@ -30,7 +30,7 @@ char* chars_to_string(const char* chars, size_t amount)
 char* copy_string(const char* string)
 {
     size_t length = strlen(string);
-    char* copy = calloc(length + 1, sizeof(char));
-    strncpy(copy, string, length);
+    char* copy = counted_calloc(length + 1, sizeof(char));
+    memcpy(copy, string, length);
     return copy;
 }
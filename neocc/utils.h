@@ -5,6 +5,45 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Heap allocations go through these so --time-report can count them.
+void* counted_malloc(size_t size);
+void* counted_calloc(size_t amount, size_t size);
+void* counted_realloc(void* pointer, size_t size);
+
+typedef struct AllocationCounts {
+    size_t allocations;
+    size_t bytes;
+} AllocationCounts;
+
+// Totals since startup, over all threads.
+AllocationCounts allocation_counts();
+
+typedef struct TimeReportPhase {
+    const char* name;
+    double seconds;
+    // peak resident set size in KiB of the compiler and of the processes
+    // it waited for, at the end of the phase
+    long peak_rss;
+    long children_peak_rss;
+    AllocationCounts counts;
+} TimeReportPhase;
+
+#define TIME_REPORT_MAX_PHASES 16
+
+typedef struct TimeReport {
+    TimeReportPhase phases[TIME_REPORT_MAX_PHASES];
+    size_t phases_length;
+    double m_start;
+    AllocationCounts m_start_counts;
+} TimeReport;
+
+TimeReport* new_time_report();
+void delete_time_report(TimeReport* self);
+void time_report_begin(TimeReport* self, const char* name);
+void time_report_end(TimeReport* self);
+void time_report_print(TimeReport* self, FILE* fp);
+char* time_report_to_json(TimeReport* self);
+
 typedef struct List {
     void (*delete)(struct List* self);
     size_t (*length)(struct List* self);
@@ -14,6 +53,10 @@ typedef struct List {
     void (*delete_all)(struct List* self, void (*)(void*));
 } List;
 
+// Calls work(context, index) for every index below count, spread over up
+// to jobs threads. Indices are handed out in increasing order.
+void parallel_for(size_t count, int jobs, void (*work)(void* context, size_t index), void* context);
+
 void list_free_all_and_self(List* list);
 void list_delete_all_and_self(List* list, void (*deletor)(void*));
 
@@ -25,6 +68,7 @@ typedef struct ArrayList {
     void (*free_all)(struct ArrayList* self);
     void (*delete_all)(struct ArrayList* self, void (*)(void*));
     size_t m_length;
+    size_t m_capacity;
     void** m_elements;
 } ArrayList;
 
@@ -33,6 +77,8 @@ void delete_array_list(ArrayList* self);
 size_t array_list_length(ArrayList* self);
 void* array_list_get(ArrayList* self, int index);
 void array_list_add(ArrayList* self, void* element);
+void array_list_reserve(ArrayList* self, size_t capacity);
+void array_list_shrink_to_fit(ArrayList* self);
 void array_list_free_all(ArrayList* self);
 void array_list_delete_all(ArrayList* self, void (*)(void*));
 
@@ -42,27 +88,31 @@ typedef struct Map {
     void* (*get)(struct Map* self, const char* string);
     void (*set)(struct Map* self, const char* string, void* value);
     bool (*contains_key)(struct Map* self, const char* string);
+    bool (*remove)(struct Map* self, const char* string);
 } Map;
 
+uint64_t hash_chars(const char* chars, size_t length);
 uint64_t hash_string(const char* value);
 
+// An empty slot has a NULL key.
 typedef struct StringHashMapElement {
     char* key;
+    size_t key_length;
     uint64_t hash;
     void* value;
 } StringHashMapElement;
 
-StringHashMapElement* new_string_hash_map_element(char* key, uint64_t hash, void* value);
-void delete_string_hash_map_element(StringHashMapElement* self);
-
+// Open addressing with Robin Hood probing and backward shift deletion.
 typedef struct StringHashMap {
     void (*delete)(struct StringHashMap* self);
     size_t (*length)(struct StringHashMap* self);
     void* (*get)(struct StringHashMap* self, const char* string);
     void (*set)(struct StringHashMap* self, const char* string, void* value);
     bool (*contains_key)(struct StringHashMap* self, const char* string);
+    bool (*remove)(struct StringHashMap* self, const char* string);
     size_t m_length;
-    List* m_elements;
+    size_t m_capacity;
+    StringHashMapElement* m_elements;
 } StringHashMap;
 
 StringHashMap* new_string_hash_map();
@@ -71,6 +121,12 @@ size_t string_hash_map_length(StringHashMap* self);
 void* string_hash_map_get(StringHashMap* self, const char* string);
 void string_hash_map_set(StringHashMap* self, const char* string, void* value);
 bool string_hash_map_contains_key(StringHashMap* self, const char* string);
+bool string_hash_map_remove(StringHashMap* self, const char* string);
+StringHashMapElement* string_hash_map_find(StringHashMap* self, const char* key, size_t key_length);
+void string_hash_map_set_chars(StringHashMap* self, const char* key, size_t key_length, void* value);
+bool string_hash_map_remove_chars(StringHashMap* self, const char* key, size_t key_length);
+// Returns the next element after *cursor, which should start at 0, or NULL when done.
+StringHashMapElement* string_hash_map_iterate(StringHashMap* self, size_t* cursor);
 
 typedef struct FileReader {
     FILE* fp;
@@ -89,8 +145,43 @@ FileWriter* new_file_writer(const char* path);
 void delete_file_writer(FileWriter* self);
 void file_writer_write(FileWriter* self, char* string);
 
+// Line and column of an offset into a text, both starting at 1. Columns
+// count bytes.
+typedef struct SourcePosition {
+    size_t line;
+    size_t column;
+} SourcePosition;
+
+// Where every line of a text starts, found in one pass, so that positions
+// are only computed for the offsets that need one.
+typedef struct LineIndex {
+    size_t m_length;
+    size_t m_capacity;
+    uint32_t* m_line_starts;
+} LineIndex;
+
+LineIndex* new_line_index(const char* text, size_t length);
+void delete_line_index(LineIndex* self);
+size_t line_index_lines_length(LineIndex* self);
+// Binary searches the line starts.
+SourcePosition line_index_position(LineIndex* self, size_t offset);
+
+// Read-only view of a file, text[length] is always '\0'.
+typedef struct MappedFile {
+    const char* text;
+    size_t length;
+    // the path it was opened with, not copied
+    const char* path;
+    LineIndex* lines;
+    size_t m_mapping_length;
+} MappedFile;
+
+MappedFile* new_mapped_file(const char* path);
+void delete_mapped_file(MappedFile* self);
+
 typedef struct StringBuilder {
     size_t m_length;
+    size_t m_capacity;
     char* m_buffer;
 } StringBuilder;
 
@@ -99,7 +190,14 @@ void delete_string_builder(StringBuilder* self);
 size_t string_builder_length(StringBuilder* self);
 char* string_builder_c_string(StringBuilder* self);
 char* string_builder_buffer(StringBuilder* self);
-void string_builder_write(StringBuilder* self, char* string);
+// Hands out the built string without copying and leaves the builder empty.
+char* string_builder_take(StringBuilder* self);
+// Empties the builder but keeps its buffer for the next string.
+void string_builder_clear(StringBuilder* self);
+void string_builder_reserve(StringBuilder* self, size_t additional);
+void string_builder_write(StringBuilder* self, const char* string);
+void string_builder_write_n(StringBuilder* self, const char* chars, size_t amount);
+void string_builder_write_char(StringBuilder* self, char c);
 void string_builder_write_fmt(StringBuilder* self, const char* fmt, ...);
 
 char* chars_to_string(const char* chars, size_t amount);